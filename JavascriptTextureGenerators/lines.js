@@ -3,6 +3,8 @@ var numSlots = 1;
 // Set separateColorChannels to true to have one array index per color
 // If set to false all four channels are interleaved in one 32 bit value.
 var separateColorChannels = false;
+// Set typedArrays to true to get the images as typed arrays over the
+// images' memory, if supported by the engine. The 32 bit values are then ARGB.
 
 function generate(data, sourceImg) {
   var obj = JSON.parse(data);
@@ -1,5 +1,9 @@
 TEMPLATE = app
 TARGET = "ProceduralTextureMaker"
+# Part of the render cache keys of the built-in generators. Increase it
+# when a generator's output changes.
+VERSION = 1.0.0
+DEFINES += APP_VERSION=\\\"$$VERSION\\\"
 
 macx {
   # Possible to include spaces in the file name if on Mac OS X.
@@ -36,6 +40,7 @@ else {
 }}
 
 QT += xml \
+    concurrent \
     widgets \
     gui \
     core
@@ -52,6 +57,12 @@ SOURCES = \
     base/texturerenderthread.cpp \
     base/settingsmanager.cpp \
     base/textureproject.cpp \
+    base/blockcompression.cpp \
+    base/exportjob.cpp \
+    base/parallelbands.cpp \
+    base/rendercache.cpp \
+    base/shaperasterizer.cpp \
+    base/warpsampler.cpp \
     gui/nodesettingswidget.cpp \
     gui/mainwindow.cpp \
     gui/addnodepanel.cpp \
@@ -73,6 +84,7 @@ SOURCES = \
     generators/circle.cpp \
     generators/cutout.cpp \
     generators/displacementmap.cpp \
+    generators/expression.cpp \
     generators/empty.cpp \
     generators/fill.cpp \
     generators/fire.cpp \
@@ -91,6 +103,7 @@ SOURCES = \
     generators/normalmap.cpp \
     generators/perlinnoise.cpp \
     generators/pixelate.cpp \
+    generators/plugins.cpp \
     generators/pointillism.cpp \
     generators/shadow.cpp \
     generators/sinetransform.cpp \
@@ -112,6 +125,13 @@ HEADERS += \
     base/texturerenderthread.h \
     base/settingsmanager.h \
     base/textureproject.h \
+    base/blockcompression.h \
+    base/counterrandom.h \
+    base/exportjob.h \
+    base/parallelbands.h \
+    base/rendercache.h \
+    base/shaperasterizer.h \
+    base/warpsampler.h \
     gui/addnodepanel.h \
     gui/qdoubleslider.h \
     gui/nodesettingswidget.h \
@@ -128,6 +148,7 @@ HEADERS += \
     sceneview/viewnodeline.h \
     sceneview/viewnodeview.h \
     generators/texturegenerator.h \
+    generators/texturegeneratorplugin.h \
     generators/blending.h \
     generators/bricks.h \
     generators/boxblur.h \
@@ -135,6 +156,7 @@ HEADERS += \
     generators/cutout.h \
     generators/circle.h \
     generators/displacementmap.h \
+    generators/expression.h \
     generators/empty.h \
     generators/fill.h \
     generators/fire.h \
@@ -153,6 +175,7 @@ HEADERS += \
     generators/normalmap.h \
     generators/perlinnoise.h \
     generators/pixelate.h \
+    generators/plugins.h \
     generators/pointillism.h \
     generators/shadow.h \
     generators/sineplasma.h \
@@ -0,0 +1,615 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include "blockcompression.h"
+#include "parallelbands.h"
+#include <QDataStream>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+/**
+ * @brief fetchBlock
+ * @param source The image.
+ * @param size Image size.
+ * @param blockX Block column.
+ * @param blockY Block row.
+ * @param block Receives the block's pixels as RGBA.
+ *
+ * Blocks on the right and bottom edges of images whose size isn't
+ * a multiple of 4 are padded by repeating the last column and row.
+ */
+static inline void fetchBlock(const TexturePixel* source, QSize size,
+                              int blockX, int blockY, int block[16][4])
+{
+   for (int y = 0; y < 4; y++) {
+      int sourceY = qMin(blockY * 4 + y, size.height() - 1);
+      for (int x = 0; x < 4; x++) {
+         int sourceX = qMin(blockX * 4 + x, size.width() - 1);
+         const TexturePixel& pixel = source[sourceY * size.width() + sourceX];
+         block[y * 4 + x][0] = pixel.r;
+         block[y * 4 + x][1] = pixel.g;
+         block[y * 4 + x][2] = pixel.b;
+         block[y * 4 + x][3] = pixel.a;
+      }
+   }
+}
+
+/**
+ * @brief principalAxis
+ * @param block The block's pixels.
+ * @param channels Number of channels used, 3 for RGB and 4 for RGBA.
+ * @param mean Receives the mean color.
+ * @param axis Receives the unit direction the colors vary the most along.
+ * @return false if no axis was found, e.g. for a block of a single color.
+ *
+ * Finds the covariance matrix's dominant eigenvector by power iteration.
+ * The best endpoints for a block lie near the line through the mean
+ * along this axis. The iteration starts from the covariance row of the
+ * channel with the largest variance. A fixed start such as (1, 1, 1) fails
+ * for blocks whose colors only differ orthogonally to it, like a red and
+ * green checker.
+ */
+static bool principalAxis(const int block[16][4], int channels, float mean[4], float axis[4])
+{
+   for (int c = 0; c < channels; c++) {
+      mean[c] = 0;
+      for (int i = 0; i < 16; i++) {
+         mean[c] += block[i][c];
+      }
+      mean[c] /= 16;
+   }
+   float covariance[4][4] = {};
+   for (int i = 0; i < 16; i++) {
+      for (int c1 = 0; c1 < channels; c1++) {
+         for (int c2 = 0; c2 < channels; c2++) {
+            covariance[c1][c2] += (block[i][c1] - mean[c1]) * (block[i][c2] - mean[c2]);
+         }
+      }
+   }
+   int seed = 0;
+   for (int c = 1; c < channels; c++) {
+      if (covariance[c][c] > covariance[seed][seed]) {
+         seed = c;
+      }
+   }
+   for (int c = 0; c < channels; c++) {
+      axis[c] = covariance[seed][c];
+   }
+   for (int iteration = 0; iteration < 8; iteration++) {
+      float next[4] = {};
+      float largest = 0;
+      for (int c1 = 0; c1 < channels; c1++) {
+         for (int c2 = 0; c2 < channels; c2++) {
+            next[c1] += covariance[c1][c2] * axis[c2];
+         }
+         largest = qMax(largest, std::fabs(next[c1]));
+      }
+      if (largest < 1e-6f) {
+         break;
+      }
+      for (int c = 0; c < channels; c++) {
+         axis[c] = next[c] / largest;
+      }
+   }
+   float length = 0;
+   for (int c = 0; c < channels; c++) {
+      length += axis[c] * axis[c];
+   }
+   length = std::sqrt(length);
+   if (length < 1e-6f) {
+      return false;
+   }
+   for (int c = 0; c < channels; c++) {
+      axis[c] /= length;
+   }
+   return true;
+}
+
+/**
+ * @brief axisEndpoints
+ * @param block The block's pixels.
+ * @param channels Number of channels used.
+ * @param start Receives the endpoint at the lowest projection.
+ * @param end Receives the endpoint at the highest projection.
+ *
+ * Falls back to the per-channel minimum and maximum if the block has no
+ * principal axis.
+ */
+static void axisEndpoints(const int block[16][4], int channels, float start[4], float end[4])
+{
+   float mean[4];
+   float axis[4];
+   if (!principalAxis(block, channels, mean, axis)) {
+      for (int c = 0; c < channels; c++) {
+         start[c] = 255;
+         end[c] = 0;
+         for (int i = 0; i < 16; i++) {
+            start[c] = qMin(start[c], (float) block[i][c]);
+            end[c] = qMax(end[c], (float) block[i][c]);
+         }
+      }
+      return;
+   }
+   float minT = 0;
+   float maxT = 0;
+   for (int i = 0; i < 16; i++) {
+      float t = 0;
+      for (int c = 0; c < channels; c++) {
+         t += (block[i][c] - mean[c]) * axis[c];
+      }
+      minT = qMin(minT, t);
+      maxT = qMax(maxT, t);
+   }
+   for (int c = 0; c < channels; c++) {
+      start[c] = qBound(0.0f, mean[c] + axis[c] * minT, 255.0f);
+      end[c] = qBound(0.0f, mean[c] + axis[c] * maxT, 255.0f);
+   }
+}
+
+/**
+ * @brief packColor565
+ * @param color RGB, 0 to 255.
+ * @return The color in the 5:6:5 bit format.
+ */
+static inline quint16 packColor565(const float color[3])
+{
+   int r = qBound(0, (int) std::lround(color[0] * 31 / 255), 31);
+   int g = qBound(0, (int) std::lround(color[1] * 63 / 255), 63);
+   int b = qBound(0, (int) std::lround(color[2] * 31 / 255), 31);
+   return (quint16) ((r << 11) | (g << 5) | b);
+}
+
+/**
+ * @brief unpackColor565
+ * @param packed The color in the 5:6:5 bit format.
+ * @param color Receives RGB, 0 to 255, as expanded by the GPU.
+ */
+static inline void unpackColor565(quint16 packed, int color[3])
+{
+   int r = (packed >> 11) & 31;
+   int g = (packed >> 5) & 63;
+   int b = packed & 31;
+   color[0] = (r << 3) | (r >> 2);
+   color[1] = (g << 2) | (g >> 4);
+   color[2] = (b << 3) | (b >> 2);
+}
+
+/**
+ * @brief fitColorIndices
+ * @param block The block's pixels.
+ * @param color0 First endpoint, swapped with color1 if needed.
+ * @param color1 Second endpoint.
+ * @param indices Receives the 2 bit indices, pixel 0 in the lowest bits.
+ * @return The block's squared error.
+ *
+ * Uses the four color mode, which requires color0 to be the larger value.
+ */
+static int fitColorIndices(const int block[16][4], quint16& color0, quint16& color1, quint32* indices)
+{
+   if (color0 < color1) {
+      qSwap(color0, color1);
+   }
+   int palette[4][3];
+   unpackColor565(color0, palette[0]);
+   unpackColor565(color1, palette[1]);
+   for (int c = 0; c < 3; c++) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+   }
+   int numColors = (color0 == color1) ? 1 : 4;
+   int totalError = 0;
+   quint32 bits = 0;
+   for (int i = 0; i < 16; i++) {
+      int bestIndex = 0;
+      int bestError = INT_MAX;
+      for (int k = 0; k < numColors; k++) {
+         int error = 0;
+         for (int c = 0; c < 3; c++) {
+            int diff = block[i][c] - palette[k][c];
+            error += diff * diff;
+         }
+         if (error < bestError) {
+            bestError = error;
+            bestIndex = k;
+         }
+      }
+      bits |= (quint32) bestIndex << (2 * i);
+      totalError += bestError;
+   }
+   *indices = bits;
+   return totalError;
+}
+
+/**
+ * @brief encodeColorBlock
+ * @param block The block's pixels.
+ * @param dest Receives the 8 byte BC1 color block.
+ *
+ * The endpoints start at the ends of the colors' principal axis and are
+ * then refitted to the chosen indices by least squares, keeping whichever
+ * gives the smaller error.
+ */
+static void encodeColorBlock(const int block[16][4], uchar* dest)
+{
+   float start[4];
+   float end[4];
+   axisEndpoints(block, 3, start, end);
+   quint16 color0 = packColor565(end);
+   quint16 color1 = packColor565(start);
+   quint32 indices;
+   int error = fitColorIndices(block, color0, color1, &indices);
+
+   if (error > 0 && color0 != color1) {
+      // The weight of color0 for each index in the four color mode.
+      static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+      float aa = 0, bb = 0, ab = 0;
+      float ax[3] = {};
+      float bx[3] = {};
+      for (int i = 0; i < 16; i++) {
+         float alpha = weights[(indices >> (2 * i)) & 3];
+         float beta = 1 - alpha;
+         aa += alpha * alpha;
+         bb += beta * beta;
+         ab += alpha * beta;
+         for (int c = 0; c < 3; c++) {
+            ax[c] += alpha * block[i][c];
+            bx[c] += beta * block[i][c];
+         }
+      }
+      float determinant = aa * bb - ab * ab;
+      if (std::fabs(determinant) > 1e-6f) {
+         float refined0[3];
+         float refined1[3];
+         for (int c = 0; c < 3; c++) {
+            refined0[c] = qBound(0.0f, (ax[c] * bb - bx[c] * ab) / determinant, 255.0f);
+            refined1[c] = qBound(0.0f, (bx[c] * aa - ax[c] * ab) / determinant, 255.0f);
+         }
+         quint16 refinedColor0 = packColor565(refined0);
+         quint16 refinedColor1 = packColor565(refined1);
+         quint32 refinedIndices;
+         int refinedError = fitColorIndices(block, refinedColor0, refinedColor1, &refinedIndices);
+         if (refinedError < error) {
+            color0 = refinedColor0;
+            color1 = refinedColor1;
+            indices = refinedIndices;
+         }
+      }
+   }
+   dest[0] = color0 & 0xff;
+   dest[1] = color0 >> 8;
+   dest[2] = color1 & 0xff;
+   dest[3] = color1 >> 8;
+   for (int i = 0; i < 4; i++) {
+      dest[4 + i] = (indices >> (8 * i)) & 0xff;
+   }
+}
+
+/**
+ * @brief encodeChannelBlock
+ * @param block The block's pixels.
+ * @param channel The channel to encode, 0 to 3 for RGBA.
+ * @param dest Receives the 8 byte BC4 block.
+ *
+ * Uses the eight value mode with the block's minimum and maximum as
+ * endpoints. Used for BC4, for each channel of BC5 and for BC3's alpha.
+ */
+static void encodeChannelBlock(const int block[16][4], int channel, uchar* dest)
+{
+   int minValue = 255;
+   int maxValue = 0;
+   for (int i = 0; i < 16; i++) {
+      minValue = qMin(minValue, block[i][channel]);
+      maxValue = qMax(maxValue, block[i][channel]);
+   }
+   quint64 bits = 0;
+   if (maxValue > minValue) {
+      float scale = 7.0f / (maxValue - minValue);
+      for (int i = 0; i < 16; i++) {
+         // Steps from the maximum, where index 0 is the maximum,
+         // 1 the minimum and 2 to 7 the values in between.
+         int step = (int) std::lround((maxValue - block[i][channel]) * scale);
+         quint64 index = (step == 0) ? 0 : (step == 7) ? 1 : step + 1;
+         bits |= index << (3 * i);
+      }
+   }
+   dest[0] = maxValue;
+   dest[1] = minValue;
+   for (int i = 0; i < 6; i++) {
+      dest[2 + i] = (bits >> (8 * i)) & 0xff;
+   }
+}
+
+/**
+ * @brief The BitWriter struct
+ * Writes bit fields into a block, starting from the lowest bit.
+ */
+struct BitWriter {
+   uchar* dest;
+   int position;
+
+   void write(quint32 value, int numBits)
+   {
+      for (int i = 0; i < numBits; i++, position++) {
+         if ((value >> i) & 1) {
+            dest[position >> 3] |= 1 << (position & 7);
+         }
+      }
+   }
+};
+
+/**
+ * @brief encodeBC7Block
+ * @param block The block's pixels.
+ * @param dest Receives the 16 byte BC7 block.
+ *
+ * Encodes the block in mode 6: one subset with RGBA endpoints of 7 bits
+ * and a shared low bit per endpoint, and 4 bit indices.
+ */
+static void encodeBC7Block(const int block[16][4], uchar* dest)
+{
+   static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+   float endpoints[2][4];
+   axisEndpoints(block, 4, endpoints[0], endpoints[1]);
+
+   int quantized[2][4];
+   int pbits[2];
+   int expanded[2][4];
+   for (int e = 0; e < 2; e++) {
+      int bestError = INT_MAX;
+      for (int pbit = 0; pbit < 2; pbit++) {
+         int values[4];
+         int error = 0;
+         for (int c = 0; c < 4; c++) {
+            values[c] = qBound(0, (int) std::lround((endpoints[e][c] - pbit) / 2), 127);
+            int diff = ((values[c] << 1) | pbit) - (int) std::lround(endpoints[e][c]);
+            error += diff * diff;
+         }
+         if (error < bestError) {
+            bestError = error;
+            pbits[e] = pbit;
+            for (int c = 0; c < 4; c++) {
+               quantized[e][c] = values[c];
+               expanded[e][c] = (values[c] << 1) | pbit;
+            }
+         }
+      }
+   }
+
+   int palette[16][4];
+   for (int k = 0; k < 16; k++) {
+      for (int c = 0; c < 4; c++) {
+         palette[k][c] = ((64 - weights[k]) * expanded[0][c] + weights[k] * expanded[1][c] + 32) >> 6;
+      }
+   }
+   int indices[16];
+   for (int i = 0; i < 16; i++) {
+      int bestError = INT_MAX;
+      for (int k = 0; k < 16; k++) {
+         int error = 0;
+         for (int c = 0; c < 4; c++) {
+            int diff = block[i][c] - palette[k][c];
+            error += diff * diff;
+         }
+         if (error < bestError) {
+            bestError = error;
+            indices[i] = k;
+         }
+      }
+   }
+   // The first pixel's index is stored without its highest bit,
+   // which is made zero by swapping the endpoints.
+   if (indices[0] & 8) {
+      for (int c = 0; c < 4; c++) {
+         qSwap(quantized[0][c], quantized[1][c]);
+      }
+      qSwap(pbits[0], pbits[1]);
+      for (int i = 0; i < 16; i++) {
+         indices[i] = 15 - indices[i];
+      }
+   }
+
+   memset(dest, 0, 16);
+   BitWriter writer = { dest, 0 };
+   writer.write(1 << 6, 7);
+   for (int c = 0; c < 4; c++) {
+      writer.write(quantized[0][c], 7);
+      writer.write(quantized[1][c], 7);
+   }
+   writer.write(pbits[0], 1);
+   writer.write(pbits[1], 1);
+   writer.write(indices[0], 3);
+   for (int i = 1; i < 16; i++) {
+      writer.write(indices[i], 4);
+   }
+}
+
+/**
+ * @brief BlockCompression::formatFromName
+ * @param name "BC1", "BC3", "BC4", "BC5" or "BC7", in any case.
+ * @param format Receives the format.
+ * @return false if the name isn't a supported format.
+ */
+bool BlockCompression::formatFromName(const QString& name, Format* format)
+{
+   QString upperName = name.toUpper();
+   if (upperName == "BC1") {
+      *format = Format::BC1;
+   } else if (upperName == "BC3") {
+      *format = Format::BC3;
+   } else if (upperName == "BC4") {
+      *format = Format::BC4;
+   } else if (upperName == "BC5") {
+      *format = Format::BC5;
+   } else if (upperName == "BC7") {
+      *format = Format::BC7;
+   } else {
+      return false;
+   }
+   return true;
+}
+
+/**
+ * @brief BlockCompression::getBlockSize
+ * @param format
+ * @return Number of bytes per 4x4 block.
+ */
+int BlockCompression::getBlockSize(Format format)
+{
+   return (format == Format::BC1 || format == Format::BC4) ? 8 : 16;
+}
+
+/**
+ * @brief BlockCompression::compress
+ * @param data The image.
+ * @param size Image size.
+ * @param format The block format.
+ * @return The blocks, row by row.
+ */
+QByteArray BlockCompression::compress(const TexturePixel* data, QSize size, Format format)
+{
+   int blocksX = (size.width() + 3) / 4;
+   int blocksY = (size.height() + 3) / 4;
+   int blockSize = getBlockSize(format);
+   QByteArray blocks(blocksX * blocksY * blockSize, 0);
+   auto* dest = reinterpret_cast<uchar*>(blocks.data());
+   ParallelBands::run(blocksY, [=](int startY, int endY) {
+      int block[16][4];
+      for (int blockY = startY; blockY < endY; blockY++) {
+         for (int blockX = 0; blockX < blocksX; blockX++) {
+            fetchBlock(data, size, blockX, blockY, block);
+            uchar* blockDest = dest + (blockY * blocksX + blockX) * blockSize;
+            switch (format) {
+            case Format::BC1:
+               encodeColorBlock(block, blockDest);
+               break;
+            case Format::BC3:
+               encodeChannelBlock(block, 3, blockDest);
+               encodeColorBlock(block, blockDest + 8);
+               break;
+            case Format::BC4:
+               encodeChannelBlock(block, 0, blockDest);
+               break;
+            case Format::BC5:
+               encodeChannelBlock(block, 0, blockDest);
+               encodeChannelBlock(block, 1, blockDest + 8);
+               break;
+            case Format::BC7:
+               encodeBC7Block(block, blockDest);
+               break;
+            }
+         }
+      }
+   }, 1);
+   return blocks;
+}
+
+/**
+ * @brief BlockCompression::createDDS
+ * @param size Image size.
+ * @param format The blocks' format.
+ * @param blocks The blocks from compress().
+ * @return A DDS file with the image.
+ *
+ * BC1 and BC3 use the DXT1 and DXT5 codes understood by all readers,
+ * the other formats need the DX10 header extension.
+ */
+QByteArray BlockCompression::createDDS(QSize size, Format format, const QByteArray& blocks)
+{
+   QByteArray file;
+   QDataStream stream(&file, QIODevice::WriteOnly);
+   stream.setByteOrder(QDataStream::LittleEndian);
+   quint32 fourCC;
+   quint32 dxgiFormat = 0;
+   switch (format) {
+   case Format::BC1:
+      fourCC = 0x31545844; // "DXT1"
+      break;
+   case Format::BC3:
+      fourCC = 0x35545844; // "DXT5"
+      break;
+   default:
+      fourCC = 0x30315844; // "DX10"
+      dxgiFormat = (format == Format::BC4) ? 80 : (format == Format::BC5) ? 83 : 98;
+      break;
+   }
+   stream.writeRawData("DDS ", 4);
+   // Size, flags for caps, height, width, pixel format and linear size.
+   stream << quint32(124) << quint32(0x1 | 0x2 | 0x4 | 0x1000 | 0x80000);
+   stream << quint32(size.height()) << quint32(size.width()) << quint32(blocks.size());
+   // Depth, mipmap count and reserved fields.
+   for (int i = 0; i < 13; i++) {
+      stream << quint32(0);
+   }
+   // Pixel format: size, flags for the four character code, the code and unused masks.
+   stream << quint32(32) << quint32(0x4) << fourCC;
+   for (int i = 0; i < 5; i++) {
+      stream << quint32(0);
+   }
+   // Caps for a texture, caps 2 to 4 and reserved.
+   stream << quint32(0x1000);
+   for (int i = 0; i < 4; i++) {
+      stream << quint32(0);
+   }
+   if (dxgiFormat != 0) {
+      // Format, 2D texture, no misc flags, array size 1 and straight alpha.
+      stream << dxgiFormat << quint32(3) << quint32(0) << quint32(1) << quint32(1);
+   }
+   stream.writeRawData(blocks.constData(), blocks.size());
+   return file;
+}
+
+/**
+ * @brief BlockCompression::createKTX
+ * @param size Image size.
+ * @param format The blocks' format.
+ * @param blocks The blocks from compress().
+ * @return A KTX 1 file with the image.
+ */
+QByteArray BlockCompression::createKTX(QSize size, Format format, const QByteArray& blocks)
+{
+   static const char identifier[12] = {
+      '\xAB', 'K', 'T', 'X', ' ', '1', '1', '\xBB', '\r', '\n', '\x1A', '\n'
+   };
+   quint32 internalFormat = 0;
+   quint32 baseInternalFormat = 0;
+   switch (format) {
+   case Format::BC1:
+      internalFormat = 0x83F0; // GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+      baseInternalFormat = 0x1907; // GL_RGB
+      break;
+   case Format::BC3:
+      internalFormat = 0x83F3; // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+      baseInternalFormat = 0x1908; // GL_RGBA
+      break;
+   case Format::BC4:
+      internalFormat = 0x8DBB; // GL_COMPRESSED_RED_RGTC1
+      baseInternalFormat = 0x1903; // GL_RED
+      break;
+   case Format::BC5:
+      internalFormat = 0x8DBD; // GL_COMPRESSED_RG_RGTC2
+      baseInternalFormat = 0x8227; // GL_RG
+      break;
+   case Format::BC7:
+      internalFormat = 0x8E8C; // GL_COMPRESSED_RGBA_BPTC_UNORM
+      baseInternalFormat = 0x1908; // GL_RGBA
+      break;
+   }
+   QByteArray file;
+   QDataStream stream(&file, QIODevice::WriteOnly);
+   stream.setByteOrder(QDataStream::LittleEndian);
+   stream.writeRawData(identifier, 12);
+   // Endianness, type, type size, format, internal formats, width, height,
+   // depth, array elements, faces, mipmap levels and key value data size.
+   stream << quint32(0x04030201) << quint32(0) << quint32(1) << quint32(0);
+   stream << internalFormat << baseInternalFormat;
+   stream << quint32(size.width()) << quint32(size.height()) << quint32(0);
+   stream << quint32(0) << quint32(1) << quint32(1) << quint32(0);
+   stream << quint32(blocks.size());
+   stream.writeRawData(blocks.constData(), blocks.size());
+   return file;
+}
@@ -0,0 +1,39 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+#include "global.h"
+#include <QByteArray>
+#include <QSize>
+#include <QString>
+
+/**
+ * @brief The BlockCompression class
+ *
+ * Encodes images in the BCn block compression formats used by GPUs and
+ * wraps them in DDS or KTX containers. Every 4x4 pixel block is encoded
+ * on its own, and the rows of blocks are split between threads.
+ *
+ * BC1 stores opaque RGB, BC3 RGBA with a separate alpha block, BC4 the
+ * red channel and BC5 the red and green channels, e.g. the x and y of a
+ * normal map. BC7 is encoded with its single subset RGBA mode only.
+ */
+class BlockCompression
+{
+public:
+   enum class Format { BC1, BC3, BC4, BC5, BC7 };
+
+   static bool formatFromName(const QString& name, Format* format);
+   static int getBlockSize(Format format);
+   static QByteArray compress(const TexturePixel* data, QSize size, Format format);
+   static QByteArray createDDS(QSize size, Format format, const QByteArray& blocks);
+   static QByteArray createKTX(QSize size, Format format, const QByteArray& blocks);
+};
+
+#endif // BLOCKCOMPRESSION_H
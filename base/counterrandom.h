@@ -0,0 +1,52 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef COUNTERRANDOM_H
+#define COUNTERRANDOM_H
+
+#include <QtGlobal>
+
+/**
+ * @brief The CounterRandom class
+ *
+ * Stateless pseudo random numbers. Each number is a hash of the seed and
+ * a position (x, y and an index, for when a position needs more than one
+ * number), so it can be computed in any order and on any thread, and
+ * doesn't depend on the Qt version.
+ */
+class CounterRandom
+{
+public:
+   /**
+    * @brief CounterRandom::get
+    * @return 32 random bits for the seed and position
+    */
+   static quint32 get(quint32 seed, quint32 x, quint32 y = 0, quint32 index = 0) {
+      quint64 h = ((static_cast<quint64>(seed) << 32) | x) * Q_UINT64_C(0x9E3779B97F4A7C15);
+      h ^= ((static_cast<quint64>(y) << 32) | index) + Q_UINT64_C(0xD1B54A32D192ED03) + (h << 6) + (h >> 2);
+      h ^= h >> 31;
+      h *= Q_UINT64_C(0x7FB5D329728EA185);
+      h ^= h >> 27;
+      h *= Q_UINT64_C(0x81DADEF4BC2DD44D);
+      h ^= h >> 33;
+      return static_cast<quint32>(h);
+   }
+
+   /**
+    * @brief CounterRandom::bounded
+    * @return Random integer in the range [lowest, highest)
+    */
+   static int bounded(int lowest, int highest, quint32 seed, quint32 x, quint32 y = 0, quint32 index = 0) {
+      if (highest <= lowest) {
+         return lowest;
+      }
+      quint64 range = static_cast<quint64>(static_cast<qint64>(highest) - lowest);
+      return lowest + static_cast<int>((get(seed, x, y, index) * range) >> 32);
+   }
+};
+
+#endif // COUNTERRANDOM_H
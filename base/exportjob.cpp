@@ -0,0 +1,225 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include "blockcompression.h"
+#include "exportjob.h"
+#include "textureproject.h"
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QRegularExpression>
+#include <QtConcurrent>
+#include <cstring>
+
+/**
+ * @brief ExportJob::ExportJob
+ * @param project The project with the nodes.
+ * @param tasks The images to export.
+ *
+ * The job doesn't start until start() is called.
+ */
+ExportJob::ExportJob(TextureProject* project, QList<Task> tasks)
+   : project(project), tasks(std::move(tasks))
+{
+   renderPool.setMaxThreadCount(1);
+   encoderPool.setMaxThreadCount(QThread::idealThreadCount());
+   encoderQueue.release(encoderPool.maxThreadCount() * 2);
+   started = false;
+}
+
+/**
+ * @brief ExportJob::~ExportJob
+ *
+ * Cancels the job and waits for the image being rendered
+ * and the images being encoded.
+ */
+ExportJob::~ExportJob()
+{
+   cancel();
+   renderPool.waitForDone();
+   encoderPool.waitForDone();
+}
+
+/**
+ * @brief ExportJob::createTasks
+ * @param project The project with the nodes.
+ * @param nodeIds The nodes to export.
+ * @param sizes The image sizes, every node is exported in all of them.
+ * @param formats File formats, e.g. "png", every image is written in all of them.
+ * @param directory The directory the files are written to.
+ * @param compression Block compression for DDS and KTX files, see getCompression().
+ * @return One task per node, size and format.
+ *
+ * The files are named after the node, its id and the image size. The id
+ * keeps the names unique, as several nodes can have the same name or
+ * names that differ only in characters that aren't allowed. The tasks are
+ * ordered by size, so that the source images a node shares with the
+ * previous nodes are still in the texture cache.
+ */
+QList<ExportJob::Task> ExportJob::createTasks(TextureProject* project, const QList<int>& nodeIds,
+                                              const QList<QSize>& sizes, const QStringList& formats,
+                                              const QString& directory, const QString& compression)
+{
+   QList<Task> tasks;
+   for (const QSize& size : sizes) {
+      for (int nodeId : nodeIds) {
+         TextureNodePtr node = project->getNode(nodeId);
+         if (node.isNull()) {
+            continue;
+         }
+         QString baseName = node->getName();
+         baseName.replace(QRegularExpression("[^A-Za-z0-9_\\-]"), "_");
+         for (const QString& format : formats) {
+            Task task;
+            task.nodeId = nodeId;
+            task.size = size;
+            task.fileName = QDir(directory).filePath(QString("%1_%2_%3x%4.%5").arg(baseName)
+                                                     .arg(nodeId)
+                                                     .arg(size.width()).arg(size.height())
+                                                     .arg(format.toLower()));
+            task.format = format.toUpper().toLatin1();
+            task.compression = getCompression(node, compression);
+            tasks.append(task);
+         }
+      }
+   }
+   return tasks;
+}
+
+/**
+ * @brief ExportJob::getCompression
+ * @param node The node whose image is exported.
+ * @param compression "BC1", "BC3", "BC4", "BC5", "BC7" or "Auto".
+ * @return The block compression format's name.
+ *
+ * Auto picks BC5 for normal maps, keeping the x and y that a shader
+ * needs to reconstruct the normal, and BC7 for all other images.
+ */
+QByteArray ExportJob::getCompression(const TextureNodePtr& node, const QString& compression)
+{
+   if (compression.compare("Auto", Qt::CaseInsensitive) != 0) {
+      return compression.toUpper().toLatin1();
+   }
+   if (!node.isNull() && node->getGeneratorName() == "Normal-map") {
+      return "BC5";
+   }
+   return "BC7";
+}
+
+/**
+ * @brief ExportJob::start
+ *
+ * Starts rendering and encoding. Returns immediately, the progress
+ * is reported with the progress() signal and the end with finished().
+ */
+void ExportJob::start()
+{
+   if (started) {
+      return;
+   }
+   started = true;
+   QtConcurrent::run(&renderPool, [this]() { render(); });
+}
+
+/**
+ * @brief ExportJob::cancel
+ *
+ * Stops the job. Images that are being rendered or
+ * encoded are finished, but the rest are skipped.
+ */
+void ExportJob::cancel()
+{
+   cancelled.storeRelease(1);
+}
+
+/**
+ * @brief ExportJob::isCancelled
+ * @return true if cancel() has been called.
+ */
+bool ExportJob::isCancelled() const
+{
+   return cancelled.loadAcquire() != 0;
+}
+
+/**
+ * @brief ExportJob::render
+ *
+ * Runs on the render thread. Renders the tasks' images in order through
+ * the nodes, so source images are rendered once per size and shared, and
+ * queues them for encoding. Waits when the encoder queue is full.
+ */
+void ExportJob::render()
+{
+   TextureImagePtr image;
+   QPair<int, QSize> renderedFor(0, QSize());
+   for (const Task& task : tasks) {
+      if (isCancelled()) {
+         break;
+      }
+      if (image.isNull() || renderedFor.first != task.nodeId || renderedFor.second != task.size) {
+         image.reset();
+         TextureNodePtr node = project->getNode(task.nodeId);
+         if (!node.isNull()) {
+            image = node->getImage(task.size);
+            renderedFor = qMakePair(task.nodeId, task.size);
+         }
+      }
+      if (image.isNull()) {
+         numFinished.ref();
+         emit taskFailed(task.fileName);
+         emit progress(numFinished.loadAcquire(), tasks.size());
+         continue;
+      }
+      encoderQueue.acquire();
+      TextureImagePtr encodedImage = image;
+      QtConcurrent::run(&encoderPool, [this, task, encodedImage]() {
+         encode(task, encodedImage);
+         encoderQueue.release();
+      });
+   }
+   encoderPool.waitForDone();
+   emit finished(isCancelled());
+}
+
+/**
+ * @brief ExportJob::encode
+ * @param task The task the image was rendered for.
+ * @param image The rendered image.
+ *
+ * Runs on the encoder threads. Writes the image in the task's format.
+ */
+void ExportJob::encode(const Task& task, const TextureImagePtr& image)
+{
+   if (!isCancelled()) {
+      QSize size = image->getSize();
+      if (task.format == "DDS" || task.format == "KTX") {
+         BlockCompression::Format blockFormat;
+         QFile file(task.fileName);
+         if (!BlockCompression::formatFromName(task.compression, &blockFormat) ||
+             !file.open(QIODevice::WriteOnly)) {
+            emit taskFailed(task.fileName);
+         } else {
+            QByteArray blocks = BlockCompression::compress(image->getData(), size, blockFormat);
+            QByteArray contents = (task.format == "DDS")
+                  ? BlockCompression::createDDS(size, blockFormat, blocks)
+                  : BlockCompression::createKTX(size, blockFormat, blocks);
+            if (file.write(contents) != contents.size()) {
+               emit taskFailed(task.fileName);
+            }
+         }
+      } else {
+         QImage outImage(size.width(), size.height(), QImage::Format_ARGB32);
+         memcpy(outImage.bits(), image->getData(),
+                size.width() * size.height() * sizeof(TexturePixel));
+         if (!outImage.save(task.fileName, task.format.constData(), 100)) {
+            emit taskFailed(task.fileName);
+         }
+      }
+   }
+   int finishedTasks = numFinished.fetchAndAddOrdered(1) + 1;
+   emit progress(finishedTasks, tasks.size());
+}
@@ -0,0 +1,79 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef EXPORTJOB_H
+#define EXPORTJOB_H
+
+#include "texturenode.h"
+#include <QAtomicInt>
+#include <QList>
+#include <QObject>
+#include <QSemaphore>
+#include <QSize>
+#include <QStringList>
+#include <QThreadPool>
+
+class TextureProject;
+
+/**
+ * @brief The ExportJob class
+ *
+ * Renders a list of node images and writes them to files without blocking
+ * the calling thread. The images are rendered one at a time on a thread of
+ * the job's own and handed to a pool of encoder threads. At most a few
+ * rendered images wait for an encoder at any time, so a long job doesn't
+ * keep all its images in memory.
+ *
+ * The DDS and KTX formats hold block compressed images, see
+ * BlockCompression. Other formats are written with QImage.
+ */
+class ExportJob : public QObject
+{
+   Q_OBJECT
+
+public:
+   struct Task {
+      int nodeId;
+      QSize size;
+      QString fileName;
+      QByteArray format;
+      QByteArray compression;
+   };
+
+   ExportJob(TextureProject* project, QList<Task> tasks);
+   ~ExportJob() override;
+   static QList<Task> createTasks(TextureProject* project, const QList<int>& nodeIds,
+                                  const QList<QSize>& sizes, const QStringList& formats,
+                                  const QString& directory, const QString& compression = "Auto");
+   static QByteArray getCompression(const TextureNodePtr& node, const QString& compression);
+   int getNumTasks() const { return tasks.size(); }
+   bool isCancelled() const;
+
+public slots:
+   void start();
+   void cancel();
+
+signals:
+   void progress(int numFinished, int numTasks);
+   void taskFailed(const QString& fileName);
+   void finished(bool cancelled);
+
+private:
+   void render();
+   void encode(const Task& task, const TextureImagePtr& image);
+
+   TextureProject* project;
+   QList<Task> tasks;
+   QThreadPool renderPool;
+   QThreadPool encoderPool;
+   QSemaphore encoderQueue;
+   QAtomicInt numFinished;
+   QAtomicInt cancelled;
+   bool started;
+};
+
+#endif // EXPORTJOB_H
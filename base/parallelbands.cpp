@@ -0,0 +1,46 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include "parallelbands.h"
+#include <QPair>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent>
+
+/**
+ * @brief ParallelBands::run
+ * @param length Number of items, e.g. the image height when splitting rows.
+ * @param func Called once per band with the half-open range [start, end).
+ * @param minBandSize Smallest band worth handing to another thread.
+ *
+ * The bands are fixed by the length and the number of threads only, and
+ * each item belongs to exactly one band. Generators that write each item
+ * independently therefore get the same result however the bands are scheduled.
+ * The calling thread also processes bands, so it's safe to call this from
+ * a generator that is itself running on the thread pool.
+ */
+void ParallelBands::run(int length,
+                        const std::function<void(int start, int end)>& func,
+                        int minBandSize)
+{
+   if (length <= 0) {
+      return;
+   }
+   int numBands = qMin(QThreadPool::globalInstance()->maxThreadCount(),
+                       (length + minBandSize - 1) / qMax(minBandSize, 1));
+   if (numBands <= 1) {
+      func(0, length);
+      return;
+   }
+   QVector<QPair<int, int>> bands;
+   for (int i = 0; i < numBands; i++) {
+      bands.append(qMakePair(length * i / numBands, length * (i + 1) / numBands));
+   }
+   QtConcurrent::blockingMap(bands, [&func](const QPair<int, int>& band) {
+      func(band.first, band.second);
+   });
+}
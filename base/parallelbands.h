@@ -0,0 +1,29 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef PARALLELBANDS_H
+#define PARALLELBANDS_H
+
+#include <functional>
+
+/**
+ * @brief The ParallelBands class
+ *
+ * Splits a range, usually the rows or columns of an image, into
+ * contiguous bands and processes them on Qt's global thread pool.
+ * The call returns when all bands are done, so consecutive calls
+ * act as a barrier between two passes over the same image.
+ */
+class ParallelBands
+{
+public:
+   static void run(int length,
+                   const std::function<void(int start, int end)>& func,
+                   int minBandSize = 16);
+};
+
+#endif // PARALLELBANDS_H
@@ -0,0 +1,221 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include "rendercache.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <cstring>
+
+/**
+ * Header stored before the pixels in every cache file. The pixels
+ * start right after it, aligned for TexturePixel.
+ */
+struct RenderCacheHeader {
+   quint32 magic;
+   quint32 version;
+   qint32 width;
+   qint32 height;
+};
+
+static const quint32 renderCacheMagic = 0x50544D52; // "PTMR"
+static const quint32 renderCacheVersion = 1;
+
+/**
+ * @brief RenderCache::RenderCache
+ *
+ * The cache is disabled until a directory has been set and it's enabled.
+ */
+RenderCache::RenderCache()
+{
+   maxSize = 1024 * 1024 * 1024;
+   currentSize = 0;
+   enabled = false;
+}
+
+/**
+ * @brief RenderCache::setDirectory
+ * @param path Absolute path to the cache directory, created if missing.
+ */
+void RenderCache::setDirectory(const QString& path)
+{
+   QMutexLocker locker(&mutex);
+   if (path == directory) {
+      return;
+   }
+   directory = path;
+   currentSize = 0;
+   if (directory.isEmpty() || !QDir().mkpath(directory)) {
+      return;
+   }
+   QFileInfoList files = QDir(directory).entryInfoList(QStringList("*.raw"), QDir::Files);
+   for (const QFileInfo& fileInfo : files) {
+      currentSize += fileInfo.size();
+   }
+   if (currentSize > maxSize) {
+      cleanup();
+   }
+}
+
+/**
+ * @brief RenderCache::setMaxSize
+ * @param bytes The cache directory's maximum size.
+ */
+void RenderCache::setMaxSize(qint64 bytes)
+{
+   QMutexLocker locker(&mutex);
+   maxSize = bytes;
+   if (currentSize > maxSize) {
+      cleanup();
+   }
+}
+
+/**
+ * @brief RenderCache::setEnabled
+ * @param enabled
+ */
+void RenderCache::setEnabled(bool enabled)
+{
+   QMutexLocker locker(&mutex);
+   this->enabled = enabled;
+}
+
+/**
+ * @brief RenderCache::isEnabled
+ * @return true if images are read from and written to the cache.
+ */
+bool RenderCache::isEnabled() const
+{
+   QMutexLocker locker(&mutex);
+   return enabled && !directory.isEmpty();
+}
+
+/**
+ * @brief RenderCache::getFileName
+ * @param settingsHash Hash from TextureNode::getSettingsHash()
+ * @param size Image size
+ * @return The cache file's absolute path.
+ */
+QString RenderCache::getFileName(const QByteArray& settingsHash, QSize size) const
+{
+   return QString("%1/%2_%3x%4.raw").arg(directory, QString(settingsHash.toHex()))
+         .arg(size.width()).arg(size.height());
+}
+
+/**
+ * @brief RenderCache::load
+ * @param settingsHash Hash from TextureNode::getSettingsHash()
+ * @param size Image size
+ * @return The cached image, or a null pointer if it isn't in the cache.
+ *
+ * Maps the cache file and copies its pixels into a new image.
+ * The file's modification time is updated, marking it as recently used.
+ */
+TextureImagePtr RenderCache::load(const QByteArray& settingsHash, QSize size)
+{
+   QString fileName;
+   {
+      QMutexLocker locker(&mutex);
+      if (!enabled || directory.isEmpty()) {
+         return TextureImagePtr(nullptr);
+      }
+      fileName = getFileName(settingsHash, size);
+   }
+   QFile file(fileName);
+   if (!file.open(QIODevice::ReadWrite)) {
+      return TextureImagePtr(nullptr);
+   }
+   int numPixels = size.width() * size.height();
+   qint64 dataSize = (qint64) numPixels * sizeof(TexturePixel);
+   if (file.size() != (qint64) sizeof(RenderCacheHeader) + dataSize) {
+      return TextureImagePtr(nullptr);
+   }
+   uchar* mapped = file.map(0, file.size());
+   if (mapped == nullptr) {
+      return TextureImagePtr(nullptr);
+   }
+   RenderCacheHeader header;
+   memcpy(&header, mapped, sizeof(header));
+   if (header.magic != renderCacheMagic || header.version != renderCacheVersion ||
+       header.width != size.width() || header.height != size.height()) {
+      file.unmap(mapped);
+      return TextureImagePtr(nullptr);
+   }
+   auto* imageData = new TexturePixel[numPixels];
+   memcpy(imageData, mapped + sizeof(header), dataSize);
+   file.unmap(mapped);
+   file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+   return TextureImagePtr(new TextureImage(size, imageData));
+}
+
+/**
+ * @brief RenderCache::store
+ * @param settingsHash Hash from TextureNode::getSettingsHash()
+ * @param image The rendered image.
+ *
+ * Writes the image to the cache. The file is written to a temporary
+ * location first, so other threads and sessions never see partial files.
+ */
+void RenderCache::store(const QByteArray& settingsHash, const TextureImagePtr& image)
+{
+   if (image.isNull()) {
+      return;
+   }
+   QSize size = image->getSize();
+   QString fileName;
+   {
+      QMutexLocker locker(&mutex);
+      if (!enabled || directory.isEmpty()) {
+         return;
+      }
+      fileName = getFileName(settingsHash, size);
+   }
+   RenderCacheHeader header;
+   header.magic = renderCacheMagic;
+   header.version = renderCacheVersion;
+   header.width = size.width();
+   header.height = size.height();
+   qint64 dataSize = (qint64) size.width() * size.height() * sizeof(TexturePixel);
+   QSaveFile file(fileName);
+   if (!file.open(QIODevice::WriteOnly)) {
+      return;
+   }
+   file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+   file.write(reinterpret_cast<const char*>(image->getData()), dataSize);
+   if (!file.commit()) {
+      return;
+   }
+   QMutexLocker locker(&mutex);
+   currentSize += sizeof(header) + dataSize;
+   if (currentSize > maxSize) {
+      cleanup();
+   }
+}
+
+/**
+ * @brief RenderCache::cleanup
+ *
+ * Removes the least recently used files until the cache directory is
+ * down to three quarters of its maximum size, so that the cleanup isn't
+ * repeated for every new image. The mutex must be held by the caller.
+ */
+void RenderCache::cleanup()
+{
+   QFileInfoList files = QDir(directory).entryInfoList(QStringList("*.raw"), QDir::Files,
+                                                       QDir::Time);
+   qint64 keptSize = 0;
+   for (const QFileInfo& fileInfo : files) {
+      if (keptSize + fileInfo.size() <= maxSize / 4 * 3) {
+         keptSize += fileInfo.size();
+      } else if (!QFile::remove(fileInfo.absoluteFilePath())) {
+         keptSize += fileInfo.size();
+      }
+   }
+   currentSize = keptSize;
+}
@@ -0,0 +1,48 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include "textureimage.h"
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+
+/**
+ * @brief The RenderCache class
+ *
+ * Persistent cache of rendered node images, shared between sessions.
+ * Every image is a file in the cache directory named after the node's
+ * settings hash and the image size. The file is a small header followed
+ * by the raw pixels, so it can be memory mapped and copied straight into
+ * a TextureImage. When the directory grows past its maximum size the
+ * least recently used files are removed.
+ */
+class RenderCache
+{
+public:
+   RenderCache();
+   void setDirectory(const QString& path);
+   void setMaxSize(qint64 bytes);
+   void setEnabled(bool enabled);
+   bool isEnabled() const;
+   TextureImagePtr load(const QByteArray& settingsHash, QSize size);
+   void store(const QByteArray& settingsHash, const TextureImagePtr& image);
+
+private:
+   QString getFileName(const QByteArray& settingsHash, QSize size) const;
+   void cleanup();
+
+   QString directory;
+   qint64 maxSize;
+   qint64 currentSize;
+   bool enabled;
+   mutable QMutex mutex;
+};
+
+#endif // RENDERCACHE_H
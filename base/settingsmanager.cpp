@@ -10,6 +10,7 @@
 #include <QDir>
 #include <QSettings>
 #include <QSize>
+#include <QStandardPaths>
 
 /**
  * @brief SettingsManager::getPreviewSize
@@ -128,6 +129,172 @@ void SettingsManager::setJSTextureGeneratorsEnabled(bool enabled)
    }
 }
 
+/**
+ * @brief SettingsManager::getPluginGeneratorsPath
+ * @return Absolute path to the native generator plugins.
+ */
+QString SettingsManager::getPluginGeneratorsPath() const
+{
+   QString path = QSettings().value("plugingeneratorspath",
+                                    QDir::homePath() + "/TexGenPlugins").toString();
+   return QDir::toNativeSeparators(path);
+}
+
+/**
+ * @brief SettingsManager::setPluginGeneratorsPath
+ * @param path Absolute path to the native generator plugins.
+ */
+void SettingsManager::setPluginGeneratorsPath(const QString& path)
+{
+   if (path != getPluginGeneratorsPath()) {
+      QSettings settings;
+      settings.setValue("plugingeneratorspath", path);
+      settings.sync();
+      emit settingsUpdated();
+   }
+}
+
+/**
+ * @brief SettingsManager::getPluginGeneratorsEnabled
+ * @return True if native generator plugins should be loaded.
+ */
+bool SettingsManager::getPluginGeneratorsEnabled() const
+{
+   return QSettings().value("plugingeneratorsenabled", false).toBool();
+}
+
+/**
+ * @brief SettingsManager::setPluginGeneratorsEnabled
+ * @param enabled True to load native generator plugins.
+ */
+void SettingsManager::setPluginGeneratorsEnabled(bool enabled)
+{
+   if (enabled != getPluginGeneratorsEnabled()) {
+      QSettings settings;
+      settings.setValue("plugingeneratorsenabled", enabled);
+      settings.sync();
+      emit settingsUpdated();
+   }
+}
+
+/**
+ * @brief SettingsManager::getExportFormat
+ * @return File format for exported images, "png", "dds" or "ktx".
+ */
+QString SettingsManager::getExportFormat() const
+{
+   return QSettings().value("exportformat", "png").toString();
+}
+
+/**
+ * @brief SettingsManager::setExportFormat
+ * @param format File format for exported images.
+ */
+void SettingsManager::setExportFormat(const QString& format)
+{
+   if (format != getExportFormat()) {
+      QSettings settings;
+      settings.setValue("exportformat", format);
+      settings.sync();
+      emit settingsUpdated();
+   }
+}
+
+/**
+ * @brief SettingsManager::getExportCompression
+ * @return Block compression for exported DDS and KTX files, see ExportJob::getCompression.
+ */
+QString SettingsManager::getExportCompression() const
+{
+   return QSettings().value("exportcompression", "Auto").toString();
+}
+
+/**
+ * @brief SettingsManager::setExportCompression
+ * @param compression Block compression for exported DDS and KTX files.
+ */
+void SettingsManager::setExportCompression(const QString& compression)
+{
+   if (compression != getExportCompression()) {
+      QSettings settings;
+      settings.setValue("exportcompression", compression);
+      settings.sync();
+      emit settingsUpdated();
+   }
+}
+
+/**
+ * @brief SettingsManager::getRenderCachePath
+ * @return Absolute path to the directory with cached node images.
+ */
+QString SettingsManager::getRenderCachePath() const
+{
+   QString path = QSettings().value("rendercachepath",
+                                    QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                                    + "/renders").toString();
+   return QDir::toNativeSeparators(path);
+}
+
+/**
+ * @brief SettingsManager::setRenderCachePath
+ * @param path Absolute path to the directory with cached node images.
+ */
+void SettingsManager::setRenderCachePath(const QString& path)
+{
+   if (path != getRenderCachePath()) {
+      QSettings settings;
+      settings.setValue("rendercachepath", path);
+      settings.sync();
+      emit settingsUpdated();
+   }
+}
+
+/**
+ * @brief SettingsManager::getRenderCacheEnabled
+ * @return True if rendered node images should be cached on disk.
+ */
+bool SettingsManager::getRenderCacheEnabled() const
+{
+   return QSettings().value("rendercacheenabled", false).toBool();
+}
+
+/**
+ * @brief SettingsManager::setRenderCacheEnabled
+ * @param enabled True to cache rendered node images on disk.
+ */
+void SettingsManager::setRenderCacheEnabled(bool enabled)
+{
+   if (enabled != getRenderCacheEnabled()) {
+      QSettings settings;
+      settings.setValue("rendercacheenabled", enabled);
+      settings.sync();
+      emit settingsUpdated();
+   }
+}
+
+/**
+ * @brief SettingsManager::getRenderCacheSize
+ * @return The render cache's maximum size in megabytes.
+ */
+int SettingsManager::getRenderCacheSize() const
+{
+   return QSettings().value("rendercachesize", 1024).toInt();
+}
+
+/**
+ * @brief SettingsManager::setRenderCacheSize
+ * @param megabytes The render cache's maximum size.
+ */
+void SettingsManager::setRenderCacheSize(int megabytes)
+{
+   if (megabytes != getRenderCacheSize()) {
+      QSettings settings;
+      settings.setValue("rendercachesize", megabytes);
+      settings.sync();
+      emit settingsUpdated();
+   }
+}
+
 /**
  * @brief SettingsManager::getBackgroundColor
  * @return Node graph view background color
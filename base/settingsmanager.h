@@ -29,6 +29,13 @@ public:
    QSize getThumbnailSize() const;
    QString getJSTextureGeneratorsPath() const;
    bool getJSTextureGeneratorsEnabled() const;
+   QString getPluginGeneratorsPath() const;
+   bool getPluginGeneratorsEnabled() const;
+   QString getRenderCachePath() const;
+   bool getRenderCacheEnabled() const;
+   int getRenderCacheSize() const;
+   QString getExportFormat() const;
+   QString getExportCompression() const;
    QColor getPreviewBackgroundColor() const;
    QColor getBackgroundColor() const;
    int getBackgroundBrush() const;
@@ -46,6 +53,13 @@ public slots:
    void setBackgroundBrush(int val);
    void setJSTextureGeneratorsPath(const QString&);
    void setJSTextureGeneratorsEnabled(bool);
+   void setPluginGeneratorsPath(const QString&);
+   void setPluginGeneratorsEnabled(bool);
+   void setRenderCachePath(const QString&);
+   void setRenderCacheEnabled(bool);
+   void setRenderCacheSize(int);
+   void setExportFormat(const QString&);
+   void setExportCompression(const QString&);
 };
 
 #endif // SETTINGSMANAGER_H
@@ -0,0 +1,132 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include "parallelbands.h"
+#include "shaperasterizer.h"
+#include <cmath>
+#include <limits>
+
+/**
+ * @brief ShapeRasterizer::fill
+ * @param size Size of the image
+ * @param area The part of the image to draw, clipped to the image
+ * @param destimage The image, drawn on in place
+ * @param color Color of the shape
+ * @param coverage The shape's coverage function
+ *
+ * The color is alpha composited on top of the image's pixels,
+ * weighted by the coverage.
+ */
+void ShapeRasterizer::fill(QSize size, const QRect& area, TexturePixel* destimage,
+                           const QColor& color, const CoverageFunction& coverage)
+{
+   QRect clipped = area.intersected(QRect(QPoint(0, 0), size));
+   if (clipped.isEmpty() || color.alpha() == 0) {
+      return;
+   }
+   int width = size.width();
+   int startX = clipped.left();
+   int count = clipped.width();
+   float colorAlpha = color.alphaF();
+   TexturePixel colorPixel(color.red(), color.green(), color.blue());
+
+   ParallelBands::run(clipped.height(), [&](int startRow, int endRow) {
+      auto* rowCoverage = new float[count];
+      for (int y = clipped.top() + startRow; y < clipped.top() + endRow; y++) {
+         coverage(y, startX, count, rowCoverage);
+         TexturePixel* destRow = destimage + y * width + startX;
+         for (int x = 0; x < count; x++) {
+            float shapeAlpha = rowCoverage[x] * colorAlpha;
+            if (shapeAlpha <= 0) {
+               continue;
+            }
+            compositeOver(destRow[x], colorPixel, shapeAlpha);
+         }
+      }
+      delete[] rowCoverage;
+   });
+}
+
+
+/**
+ * @brief ShapeRasterizer::edgeCoverage
+ * @param signedDistance Distance in pixels from the pixel's center to the
+ *        shape's edge, negative inside the shape
+ * @param antialiasing If false, the pixel is either covered or not
+ * @return Coverage of the pixel
+ */
+float ShapeRasterizer::edgeCoverage(float signedDistance, bool antialiasing)
+{
+   if (!antialiasing) {
+      return signedDistance <= 0 ? 1 : 0;
+   }
+   return qBound(0.0f, 0.5f - signedDistance, 1.0f);
+}
+
+
+/**
+ * @brief ShapeRasterizer::spanCoverage
+ * @param pixelStart Position of the pixel's left or top edge
+ * @param start Start of the covered span
+ * @param end End of the covered span
+ * @return How much of the pixel the span covers along one axis
+ */
+float ShapeRasterizer::spanCoverage(float pixelStart, float start, float end)
+{
+   return qBound(0.0f, qMin(end, pixelStart + 1) - qMax(start, pixelStart), 1.0f);
+}
+
+
+/**
+ * @brief ShapeRasterizer::boxDistance
+ * @return Signed distance from (x, y) to a box centered on the origin
+ */
+float ShapeRasterizer::boxDistance(float x, float y, float halfWidth, float halfHeight)
+{
+   float dx = std::fabs(x) - halfWidth;
+   float dy = std::fabs(y) - halfHeight;
+   float outsideX = qMax(dx, 0.0f);
+   float outsideY = qMax(dy, 0.0f);
+   return std::sqrt(outsideX * outsideX + outsideY * outsideY) + qMin(qMax(dx, dy), 0.0f);
+}
+
+
+/**
+ * @brief ShapeRasterizer::polygonDistance
+ * @return Signed distance from (x, y) to a closed polygon
+ *
+ * The sign follows the odd-even rule, same as QPainterPath's default fill.
+ */
+float ShapeRasterizer::polygonDistance(const QVector<QPointF>& polygon, float x, float y)
+{
+   int numPoints = polygon.size();
+   if (numPoints < 3) {
+      return std::numeric_limits<float>::max();
+   }
+   float minDistanceSquared = std::numeric_limits<float>::max();
+   bool inside = false;
+   for (int i = 0, j = numPoints - 1; i < numPoints; j = i, i++) {
+      float ax = polygon[j].x();
+      float ay = polygon[j].y();
+      float bx = polygon[i].x();
+      float by = polygon[i].y();
+      float edgeX = bx - ax;
+      float edgeY = by - ay;
+      float toX = x - ax;
+      float toY = y - ay;
+      float lengthSquared = edgeX * edgeX + edgeY * edgeY;
+      float t = lengthSquared > 0 ? qBound(0.0f, (toX * edgeX + toY * edgeY) / lengthSquared, 1.0f) : 0;
+      float distX = toX - edgeX * t;
+      float distY = toY - edgeY * t;
+      minDistanceSquared = qMin(minDistanceSquared, distX * distX + distY * distY);
+      if ((ay > y) != (by > y) && x < ax + edgeX * (y - ay) / edgeY) {
+         inside = !inside;
+      }
+   }
+   float distance = std::sqrt(minDistanceSquared);
+   return inside ? -distance : distance;
+}
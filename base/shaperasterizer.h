@@ -0,0 +1,60 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef SHAPERASTERIZER_H
+#define SHAPERASTERIZER_H
+
+#include "global.h"
+#include <QColor>
+#include <QPointF>
+#include <QRect>
+#include <QSize>
+#include <QVector>
+#include <functional>
+
+/**
+ * @brief The ShapeRasterizer class
+ *
+ * Draws shapes straight into an image buffer without QPainter. The shape
+ * is given as a function returning the coverage, from 0 to 1, for a span
+ * of pixels on a row. Since the coverage of a pixel doesn't depend on any
+ * other pixel, any part of the image can be drawn on its own and the rows
+ * are split over the threads.
+ */
+class ShapeRasterizer
+{
+public:
+   /**
+    * Fills coverage with the shape's coverage of the count pixels
+    * starting at (startX, y).
+    */
+   typedef std::function<void(int y, int startX, int count, float* coverage)> CoverageFunction;
+
+   static void fill(QSize size, const QRect& area, TexturePixel* destimage,
+                    const QColor& color, const CoverageFunction& coverage);
+
+   static float edgeCoverage(float signedDistance, bool antialiasing);
+   static float spanCoverage(float pixelStart, float start, float end);
+   static float boxDistance(float x, float y, float halfWidth, float halfHeight);
+   static float polygonDistance(const QVector<QPointF>& polygon, float x, float y);
+
+   /**
+    * Alpha composites color on top of pixel, with the color's
+    * alpha replaced by alpha.
+    */
+   static inline void compositeOver(TexturePixel& pixel, const TexturePixel& color, float alpha)
+   {
+      float belowAlpha = (pixel.a / 255.0f) * (1 - alpha);
+      float resultAlpha = alpha + belowAlpha;
+      pixel.r = static_cast<unsigned char>((color.r * alpha + pixel.r * belowAlpha) / resultAlpha + 0.5f);
+      pixel.g = static_cast<unsigned char>((color.g * alpha + pixel.g * belowAlpha) / resultAlpha + 0.5f);
+      pixel.b = static_cast<unsigned char>((color.b * alpha + pixel.b * belowAlpha) / resultAlpha + 0.5f);
+      pixel.a = static_cast<unsigned char>(resultAlpha * 255 + 0.5f);
+   }
+};
+
+#endif // SHAPERASTERIZER_H
@@ -8,6 +8,7 @@
 #include "texturenode.h"
 #include "textureproject.h"
 #include <QColor>
+#include <QCryptographicHash>
 #include <QLocale>
 
 bool operator<(const QSize& lhs, const QSize& rhs)
@@ -36,6 +37,7 @@ TextureNode::TextureNode(TextureProject* project, const TextureGeneratorPtr& gen
    sources.clear();
    receivers.clear();
    deleted = false;
+   updateCount = 0;
    for (int i = 0; i < 10; i++) {
       sources.insert(i, 0);
    }
@@ -75,53 +77,71 @@ void TextureNode::release()
 
 /**
  * @brief TextureNode::loadFromXML
- * @param xmlnode Serialized data.
- * @param idMappings Mappings between new and old ids so that references are kept.
+ * @param xml Reader positioned at the node's start element.
+ * @return The connected sources, slot to source id as stored in the file.
  *
- * Set up the node's properties, including settings and connections, based on
- * the serialized data stored in XML format by the function saveAsXML().
+ * Set up the node's properties and settings based on the serialized data
+ * stored in XML format by the function saveAsXML(). Reads up to and including
+ * the node's end element. The sources are returned instead of connected, as
+ * they may refer to nodes that haven't been read yet.
  */
-void TextureNode::loadFromXML(const QDomNode& xmlnode, QMap<int, int> idMappings)
+QMap<int, int> TextureNode::loadFromXML(QXmlStreamReader& xml)
 {
-   name = xmlnode.toElement().attribute("name");
-   QDomElement pos = xmlnode.namedItem("pos").toElement();
-   if (!pos.isNull()) {
-      setPos(QPointF(pos.attribute("x").toDouble(), pos.attribute("y").toDouble()));
-   }
-   QDomElement generatornode = xmlnode.namedItem("generator").toElement();
-   if (!generatornode.isNull()) {
-      setGenerator(generatornode.attribute("name"));
-   }
-   QDomNodeList sources = xmlnode.namedItem("Sources").childNodes();
-   for (int i = 0; i < sources.count(); i++) {
-      int slotId = sources.at(i).toElement().attribute("slot").toInt();
-      int sourceId = sources.at(i).toElement().attribute("source").toInt();
-      if (idMappings.contains(sourceId)) {
-         sourceId = idMappings[sourceId];
-      }
-      setSourceSlot(slotId, sourceId);
-   }
-   QDomNodeList settings = xmlnode.namedItem("Settings").childNodes();
-   for (int i = 0; i < settings.count(); i++) {
-      QDomElement currNode = settings.at(i).toElement();
-      QString settingId = currNode.attribute("id");
-      QString settingType = currNode.attribute("type");
-      QString settingValue = currNode.attribute("value");
-      QVariant settingVariant;
-      if (settingType == "int") {
-         settingVariant = QVariant(settingValue.toInt());
-      } else if (settingType == "double") {
-         settingVariant = QVariant(settingValue.toDouble());
-      } else if (settingType == "bool") {
-         settingVariant = QVariant((bool) (settingValue == "true" ? true : false));
-      } else if (settingType == "QColor") {
-         settingVariant = QVariant(QColor(settingValue));
-      } else if (settingType == "QString") {
-         settingVariant = QVariant(QString(settingValue));
+   QMap<int, int> storedSources;
+   TextureNodeSettings storedSettings;
+   name = xml.attributes().value("name").toString();
+   while (xml.readNextStartElement()) {
+      if (xml.name() == QLatin1String("pos")) {
+         setPos(QPointF(xml.attributes().value("x").toDouble(),
+                        xml.attributes().value("y").toDouble()));
+         xml.skipCurrentElement();
+      } else if (xml.name() == QLatin1String("generator")) {
+         setGenerator(xml.attributes().value("name").toString());
+         xml.skipCurrentElement();
+      } else if (xml.name() == QLatin1String("Settings")) {
+         while (xml.readNextStartElement()) {
+            if (xml.name() == QLatin1String("setting")) {
+               QXmlStreamAttributes attributes = xml.attributes();
+               QString settingType = attributes.value("type").toString();
+               QString settingValue = attributes.value("value").toString();
+               QVariant settingVariant;
+               if (settingType == "int") {
+                  settingVariant = QVariant(settingValue.toInt());
+               } else if (settingType == "double") {
+                  settingVariant = QVariant(settingValue.toDouble());
+               } else if (settingType == "bool") {
+                  settingVariant = QVariant((bool) (settingValue == "true" ? true : false));
+               } else if (settingType == "QColor") {
+                  settingVariant = QVariant(QColor(settingValue));
+               } else if (settingType == "QString") {
+                  settingVariant = QVariant(QString(settingValue));
+               }
+               storedSettings.insert(attributes.value("id").toString(), settingVariant);
+            }
+            xml.skipCurrentElement();
+         }
+      } else if (xml.name() == QLatin1String("Sources")) {
+         while (xml.readNextStartElement()) {
+            if (xml.name() == QLatin1String("source")) {
+               storedSources.insert(xml.attributes().value("slot").toInt(),
+                                    xml.attributes().value("source").toInt());
+            }
+            xml.skipCurrentElement();
+         }
+      } else {
+         xml.skipCurrentElement();
       }
-      this->settings.insert(settingId, settingVariant);
    }
-   emit settingsUpdated(id);
+   settingsmutex.lockForRead();
+   TextureNodeSettings newSettings(settings);
+   settingsmutex.unlock();
+   QMapIterator<QString, QVariant> settingsiterator(storedSettings);
+   while (settingsiterator.hasNext()) {
+      settingsiterator.next();
+      newSettings.insert(settingsiterator.key(), settingsiterator.value());
+   }
+   setSettings(newSettings);
+   return storedSources;
 }
 
 /**
@@ -186,6 +206,161 @@ QDomElement TextureNode::saveAsXML(QDomDocument targetdoc)
    return retXmlNode;
 }
 
+/**
+ * @brief TextureNode::loadFromBinary
+ * @param stream Serialized data, positioned at the start of the node's record.
+ * @param idMappings Mappings between new and old ids so that references are kept.
+ *
+ * Binary counterpart of loadFromXML(), reading the record written by saveAsBinary().
+ * The settings keep their types, so no string conversions are needed.
+ */
+void TextureNode::loadFromBinary(QDataStream& stream, const QMap<int, int> idMappings)
+{
+   qint32 storedId;
+   QString storedName;
+   QPointF storedPos;
+   QString generatorName;
+   TextureNodeSettings storedSettings;
+   QMap<int, int> storedSources;
+   stream >> storedId >> storedName >> storedPos >> generatorName >> storedSettings >> storedSources;
+   if (stream.status() != QDataStream::Ok) {
+      ERROR_MSG(QString("Corrupt data for node %1.").arg(storedId));
+      return;
+   }
+   name = storedName;
+   setPos(storedPos);
+   setGenerator(generatorName);
+   QMapIterator<int, int> sourceiterator(storedSources);
+   while (sourceiterator.hasNext()) {
+      sourceiterator.next();
+      int sourceId = sourceiterator.value();
+      if (idMappings.contains(sourceId)) {
+         sourceId = idMappings[sourceId];
+      }
+      setSourceSlot(sourceiterator.key(), sourceId);
+   }
+   settingsmutex.lockForRead();
+   TextureNodeSettings newSettings(settings);
+   settingsmutex.unlock();
+   QMapIterator<QString, QVariant> settingsiterator(storedSettings);
+   while (settingsiterator.hasNext()) {
+      settingsiterator.next();
+      newSettings.insert(settingsiterator.key(), settingsiterator.value());
+   }
+   setSettings(newSettings);
+}
+
+/**
+ * @brief TextureNode::saveAsBinary
+ * @param stream The stream to write the node's record to.
+ *
+ * Serializes the node's id, name, position, generator, typed settings
+ * and connected source slots. See loadFromBinary().
+ */
+void TextureNode::saveAsBinary(QDataStream& stream) const
+{
+   settingsmutex.lockForRead();
+   TextureNodeSettings settingsCopy(settings);
+   settingsmutex.unlock();
+   QMap<int, int> usedSources;
+   sourcemutex.lockForRead();
+   QMapIterator<int, int> sourcesiterator(sources);
+   while (sourcesiterator.hasNext()) {
+      sourcesiterator.next();
+      if (sourcesiterator.value() > 0) {
+         usedSources.insert(sourcesiterator.key(), sourcesiterator.value());
+      }
+   }
+   sourcemutex.unlock();
+   stream << qint32(id) << name << pos << gen->getName() << settingsCopy << usedSources;
+}
+
+/**
+ * @brief TextureNode::getSettingsHash
+ * @return SHA-1 hash of everything that affects the node's images.
+ *
+ * Covers the generator, the settings with the generator's defaults filled in
+ * and, recursively, the hashes of the connected source nodes. Two nodes with
+ * the same hash render identical images, so the hash can be stored along with
+ * cached images to tell whether they are still valid.
+ * The hash is kept until the node is updated. A hash computed while the node
+ * was being updated is returned but not kept.
+ */
+QByteArray TextureNode::getSettingsHash() const
+{
+   imagemutex.lockForRead();
+   QByteArray retHash = settingsHash;
+   int computedForUpdate = updateCount;
+   imagemutex.unlock();
+   if (!retHash.isEmpty()) {
+      return retHash;
+   }
+   settingsmutex.lockForRead();
+   TextureNodeSettings settingsCopy(settings);
+   settingsmutex.unlock();
+   QMapIterator<QString, TextureGeneratorSetting> settingsIterator(gen->getSettings());
+   while (settingsIterator.hasNext()) {
+      settingsIterator.next();
+      if (!settingsCopy.contains(settingsIterator.key())) {
+         settingsCopy.insert(settingsIterator.key(), settingsIterator.value().defaultvalue);
+      }
+   }
+   QByteArray serialized;
+   QDataStream stream(&serialized, QIODevice::WriteOnly);
+   stream.setVersion(QDataStream::Qt_5_6);
+   stream << gen->getName() << gen->getCacheKey() << settingsCopy;
+   sourcemutex.lockForRead();
+   for (int i = 0; i < getNumSourceSlots(); i++) {
+      TextureNodePtr srcNode = project->getNode(sources.value(i));
+      stream << qint32(i) << (srcNode.isNull() ? QByteArray() : srcNode->getSettingsHash());
+   }
+   sourcemutex.unlock();
+   retHash = QCryptographicHash::hash(serialized, QCryptographicHash::Sha1);
+   imagemutex.lockForWrite();
+   if (updateCount == computedForUpdate) {
+      settingsHash = retHash;
+   }
+   imagemutex.unlock();
+   return retHash;
+}
+
+/**
+ * @brief TextureNode::insertCachedImage
+ * @param settingsHash The hash from getSettingsHash() when the image was rendered.
+ * @param image Previously rendered image.
+ * @return true if the image was accepted.
+ *
+ * Puts an image rendered earlier, for example one stored in a project file,
+ * into the texture cache so it doesn't have to be rendered again. The image
+ * is only used if the node's current settings hash matches.
+ */
+bool TextureNode::insertCachedImage(const QByteArray& settingsHash, const TextureImagePtr& image)
+{
+   if (image.isNull() || settingsHash != getSettingsHash()) {
+      return false;
+   }
+   QSize size = image->getSize();
+   imagemutex.lockForWrite();
+   if (!texturecache.contains(size)) {
+      texturecache.insert(size, image);
+   }
+   imagemutex.unlock();
+   emit imageAvailable(id, size);
+   return true;
+}
+
+/**
+ * @brief TextureNode::getCachedImages
+ * @return all the images currently in the texture cache.
+ */
+QList<TextureImagePtr> TextureNode::getCachedImages() const
+{
+   imagemutex.lockForRead();
+   QList<TextureImagePtr> images = texturecache.values();
+   imagemutex.unlock();
+   return images;
+}
+
 /**
  * @brief TextureNode::setName
  * @param newname
@@ -350,6 +525,8 @@ void TextureNode::setUpdated()
    imagemutex.lockForWrite();
    texturecache.clear();
    validImage.clear();
+   settingsHash.clear();
+   updateCount++;
    imagemutex.unlock();
    QSetIterator<int> receiveriter(receivers);
    receivermutex.lockForRead();
@@ -369,6 +546,8 @@ void TextureNode::setUpdated()
  * size has already been calculated, and the image or its sources' settings
  * since then haven't since been changed, the image is returned immediately
  * from the cache.
+ * If the render cache is enabled and has an image for the node's settings
+ * hash it's used instead of rendering, without rendering the sources.
  * If the node has source nodes whose images haven't been calculated those
  * nodes are calculated first. Thus the waiting time for this call can be long.
  * This call is thread safe and contains several mutexes for various node properties.
@@ -391,6 +570,22 @@ TextureImagePtr TextureNode::getImage(QSize size)
    validImage.insert(size, true);
    imagemutex.unlock();
 
+   RenderCache* renderCache = project->getRenderCache();
+   QByteArray cacheHash;
+   if (renderCache->isEnabled()) {
+      cacheHash = getSettingsHash();
+      retImage = renderCache->load(cacheHash, size);
+      if (!retImage.isNull()) {
+         imagemutex.lockForWrite();
+         if (validImage.value(size)) {
+            texturecache.insert(size, retImage);
+            emit imageAvailable(id, size);
+         }
+         imagemutex.unlock();
+         return retImage;
+      }
+   }
+
    // All the node's source
    QMap<int, TextureImagePtr> sourceImages;
    for (int i = 0; i < getNumSourceSlots(); i++) {
@@ -428,8 +623,13 @@ TextureImagePtr TextureNode::getImage(QSize size)
       imagemutex.lockForWrite();
       texturecache.insert(size, retImage);
       emit imageAvailable(id, size);
+      imagemutex.unlock();
+      if (!cacheHash.isEmpty()) {
+         renderCache->store(cacheHash, retImage);
+      }
+   } else {
+      imagemutex.unlock();
    }
-   imagemutex.unlock();
    return retImage;
 }
 
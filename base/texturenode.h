@@ -11,11 +11,13 @@
 #include "generators/texturegenerator.h"
 #include "global.h"
 #include "textureimage.h"
+#include <QDataStream>
 #include <QDomNode>
 #include <QMap>
 #include <QPoint>
 #include <QReadWriteLock>
 #include <QSet>
+#include <QXmlStreamReader>
 
 class TextureProject;
 class TextureNode;
@@ -62,6 +64,9 @@ public:
    const TextureNodeSettings getSettings() const { return settings; }
    void setSettings(const TextureNodeSettings& settings);
    const QMap<int, int> getSources() const { return sources; }
+   QByteArray getSettingsHash() const;
+   bool insertCachedImage(const QByteArray& settingsHash, const TextureImagePtr& image);
+   QList<TextureImagePtr> getCachedImages() const;
 
 signals:
    void positionUpdated(int id);
@@ -75,8 +80,10 @@ signals:
 
 private:
    TextureNode(TextureProject* project, const TextureGeneratorPtr& generator, int id);
-   void loadFromXML(const QDomNode& xmlnode, const QMap<int, int> idMapping = QMap<int, int>());
+   QMap<int, int> loadFromXML(QXmlStreamReader& xml);
    QDomElement saveAsXML(QDomDocument targetdoc);
+   void loadFromBinary(QDataStream& stream, const QMap<int, int> idMapping = QMap<int, int>());
+   void saveAsBinary(QDataStream& stream) const;
    bool findLoop(QList<int> visited) const;
    void removeSource(int id);
 
@@ -96,6 +103,9 @@ private:
    // Set to true after releasing all connections, before delete
    bool deleted;
    QMap<QSize, bool> validImage;
+   // Memoized result of getSettingsHash(), cleared by setUpdated()
+   mutable QByteArray settingsHash;
+   int updateCount;
 
    // Mutexes to make it thread-safe.
    mutable QReadWriteLock sourcemutex;
@@ -11,7 +11,9 @@
 #include "texturerenderthread.h"
 #include <QApplication>
 #include <QClipboard>
+#include <QDataStream>
 #include <QDebug>
+#include <QXmlStreamReader>
 
 /**
  * @brief TextureProject::TextureProject
@@ -65,10 +67,14 @@ void TextureProject::setSettingsManager(SettingsManager* manager)
  * Called when the settings manager's updated.
  * If the thumbnail size has changed a new thread for the
  * new size is created and the old thread is stopped..
+ * The render cache is reconfigured.
  */
 void TextureProject::settingsUpdated()
 {
    previewSize = settingsManager->getPreviewSize();
+   renderCache.setDirectory(settingsManager->getRenderCachePath());
+   renderCache.setMaxSize((qint64) settingsManager->getRenderCacheSize() * 1024 * 1024);
+   renderCache.setEnabled(settingsManager->getRenderCacheEnabled());
    if (settingsManager->getThumbnailSize() != getThumbnailSize()) {
       stopRenderThread(getThumbnailSize());
    }
@@ -152,40 +158,112 @@ void TextureProject::stopRenderThread(QSize renderSize)
 
 /**
  * @brief TextureProject::loadFromXML
- * @param xmlfile XML DOM object.
+ * @param device Open device with the XML data.
+ * @return false if the data isn't a valid texture set.
  *
  * Loads a whole project including node connections and settings from an XML document.
  */
-void TextureProject::loadFromXML(const QDomDocument& xmlfile)
+bool TextureProject::loadFromXML(QIODevice* device)
 {
-   QDomNode rootNode = xmlfile.namedItem("TextureSet");
-   QDomNodeList generators = rootNode.namedItem("Generators").childNodes();
-   for (int i = 0; i < generators.count(); i++) {
-      QDomNode currGenerator = generators.at(i);
-      if (!getGenerator(currGenerator.toElement().attribute("name"))) {
-         ERROR_MSG(QString("Could not find texture generator with name %1.")
-                   .arg(currGenerator.toElement().attribute("name")));
+   QXmlStreamReader xml(device);
+   if (!loadFromXML(xml, false)) {
+      ERROR_MSG(QString("Could not read texture set: %1").arg(xml.errorString()));
+      return false;
+   }
+   return true;
+}
+
+/**
+ * @brief TextureProject::isXMLProject
+ * @param data The file contents.
+ * @return true if the data is a well-formed XML document with a TextureSet root.
+ *
+ * Reads through the document without creating any nodes, so that the caller
+ * can check the file before clearing the current project.
+ */
+bool TextureProject::isXMLProject(const QByteArray& data)
+{
+   QXmlStreamReader xml(data);
+   if (!xml.readNextStartElement() || xml.name() != QLatin1String("TextureSet")) {
+      return false;
+   }
+   while (!xml.atEnd()) {
+      xml.readNext();
+   }
+   return !xml.hasError();
+}
+
+/**
+ * @brief TextureProject::loadFromXML
+ * @param xml Reader at the start of the document.
+ * @param pasted Give all the nodes new ids and keep source ids as they are.
+ * @return false if the data isn't a valid texture set.
+ *
+ * Reads the document in a single pass, creating the nodes as their elements
+ * are encountered without building a DOM tree. Node ids that collide with
+ * existing nodes are remapped. Connections are made once all nodes have
+ * been created, as a source may be stored after the node it's connected to.
+ */
+bool TextureProject::loadFromXML(QXmlStreamReader& xml, bool pasted)
+{
+   if (!xml.readNextStartElement() || xml.name() != QLatin1String("TextureSet")) {
+      if (!xml.hasError()) {
+         xml.raiseError("No TextureSet element.");
       }
+      return false;
    }
    QMap<int, int> idMappings;
-   QDomNodeList nodes = rootNode.namedItem("Nodes").childNodes();
-   for (int i = 0; i < nodes.count(); i++) {
-      QDomNode currNode = nodes.at(i);
-      int nodeId = currNode.toElement().attribute("id").toInt();
-      idMappings[nodeId] = nodeId;
-      if (getNode(nodeId) != nullptr) {
-         idMappings[nodeId] = getNewId();
+   QMap<int, QMap<int, int>> nodeSources;
+   while (xml.readNextStartElement()) {
+      if (xml.name() == QLatin1String("Generators")) {
+         while (xml.readNextStartElement()) {
+            if (xml.name() == QLatin1String("generator")) {
+               QString generatorName = xml.attributes().value("name").toString();
+               if (!getGenerator(generatorName)) {
+                  ERROR_MSG(QString("Could not find texture generator with name %1.")
+                            .arg(generatorName));
+               }
+            }
+            xml.skipCurrentElement();
+         }
+      } else if (xml.name() == QLatin1String("Nodes")) {
+         while (xml.readNextStartElement()) {
+            if (xml.name() != QLatin1String("Node")) {
+               xml.skipCurrentElement();
+               continue;
+            }
+            int nodeId = 0;
+            if (!pasted) {
+               int storedId = xml.attributes().value("id").toInt();
+               nodeId = storedId;
+               if (nodeId <= 0 || getNode(nodeId) != nullptr) {
+                  nodeId = getNewId();
+               }
+               idMappings[storedId] = nodeId;
+            }
+            TextureNodePtr node = newNode(nodeId);
+            nodeSources.insert(node->getId(), node->loadFromXML(xml));
+            if (pasted) {
+               node->setPos(QPointF(node->getPos().x() + this->nodes.size() * 15,
+                                    node->getPos().y() + this->nodes.size() * 15));
+            }
+         }
+      } else {
+         xml.skipCurrentElement();
       }
    }
-   QMapIterator<int, int> nodeiterator(idMappings);
+   QMapIterator<int, QMap<int, int>> nodeiterator(nodeSources);
    while (nodeiterator.hasNext()) {
-      newNode(nodeiterator.next().value());
-   }
-   for (int i = 0; i < nodes.count(); i++) {
-      QDomNode currNode = nodes.at(i);
-      int nodeId = currNode.toElement().attribute("id").toInt();
-      getNode(idMappings[nodeId])->loadFromXML(currNode, idMappings);
+      nodeiterator.next();
+      TextureNodePtr node = getNode(nodeiterator.key());
+      QMapIterator<int, int> sourceiterator(nodeiterator.value());
+      while (sourceiterator.hasNext()) {
+         sourceiterator.next();
+         int sourceId = idMappings.value(sourceiterator.value(), sourceiterator.value());
+         node->setSourceSlot(sourceiterator.key(), sourceId);
+      }
    }
+   return !xml.hasError();
 }
 
 /**
@@ -231,6 +309,175 @@ QDomDocument TextureProject::saveAsXML(bool includegenerators)
    return xmldoc;
 }
 
+/**
+ * Binary project files start with the magic number and the format version,
+ * followed by chunks. Every chunk is a tag and a length-prefixed byte array,
+ * so readers can skip tags they don't know. A NODE chunk holds one node's
+ * record and an IMAG chunk one cached image, tagged with the node's id and
+ * settings hash at the time it was rendered.
+ */
+static const quint32 binaryMagic = 0x50544D42; // "PTMB"
+static const quint32 binaryVersion = 1;
+static const quint32 binaryNodeChunk = 0x4E4F4445; // "NODE"
+static const quint32 binaryImageChunk = 0x494D4147; // "IMAG"
+
+/**
+ * @brief TextureProject::isBinaryProject
+ * @param data The file contents.
+ * @return true if the data starts with a binary texture set header of a
+ *         version that can be loaded.
+ *
+ * Lets the caller check the file before clearing the current project.
+ */
+bool TextureProject::isBinaryProject(const QByteArray& data)
+{
+   QDataStream stream(data);
+   stream.setVersion(QDataStream::Qt_5_6);
+   quint32 magic;
+   quint32 version;
+   stream >> magic >> version;
+   return stream.status() == QDataStream::Ok && magic == binaryMagic &&
+         version <= binaryVersion;
+}
+
+/**
+ * @brief TextureProject::loadFromBinary
+ * @param data The file contents written by saveAsBinary().
+ * @return false if the data isn't a binary texture set.
+ *
+ * Loads a whole project from the binary format. Cached images whose settings
+ * hash still matches their node are put straight into the node's texture
+ * cache, so they're shown without being rendered again.
+ */
+bool TextureProject::loadFromBinary(const QByteArray& data)
+{
+   if (!isBinaryProject(data)) {
+      ERROR_MSG(QString("Not a supported binary texture set."));
+      return false;
+   }
+   QDataStream stream(data);
+   stream.setVersion(QDataStream::Qt_5_6);
+   // Skip the magic number and version, checked above.
+   stream.skipRawData(2 * sizeof(quint32));
+   QList<QByteArray> nodeChunks;
+   QList<QByteArray> imageChunks;
+   while (!stream.atEnd()) {
+      quint32 tag;
+      QByteArray chunk;
+      stream >> tag >> chunk;
+      if (stream.status() != QDataStream::Ok) {
+         ERROR_MSG(QString("Truncated binary texture set."));
+         break;
+      }
+      if (tag == binaryNodeChunk) {
+         nodeChunks.append(chunk);
+      } else if (tag == binaryImageChunk) {
+         imageChunks.append(chunk);
+      }
+   }
+
+   QMap<int, int> idMappings;
+   QList<int> nodeIds;
+   for (const QByteArray& chunk : nodeChunks) {
+      QDataStream chunkStream(chunk);
+      chunkStream.setVersion(QDataStream::Qt_5_6);
+      qint32 nodeId;
+      chunkStream >> nodeId;
+      nodeIds.append(nodeId);
+      idMappings[nodeId] = nodeId;
+      if (getNode(nodeId) != nullptr) {
+         idMappings[nodeId] = getNewId();
+      }
+   }
+   QMapIterator<int, int> nodeiterator(idMappings);
+   while (nodeiterator.hasNext()) {
+      newNode(nodeiterator.next().value());
+   }
+   for (int i = 0; i < nodeChunks.count(); i++) {
+      QDataStream chunkStream(nodeChunks.at(i));
+      chunkStream.setVersion(QDataStream::Qt_5_6);
+      getNode(idMappings[nodeIds.at(i)])->loadFromBinary(chunkStream, idMappings);
+   }
+
+   for (const QByteArray& chunk : imageChunks) {
+      QDataStream chunkStream(chunk);
+      chunkStream.setVersion(QDataStream::Qt_5_6);
+      qint32 nodeId;
+      QByteArray settingsHash;
+      QSize size;
+      bool compressed;
+      QByteArray pixels;
+      chunkStream >> nodeId >> settingsHash >> size >> compressed >> pixels;
+      if (chunkStream.status() != QDataStream::Ok || !idMappings.contains(nodeId)) {
+         continue;
+      }
+      if (compressed) {
+         pixels = qUncompress(pixels);
+      }
+      int numPixels = size.width() * size.height();
+      if (size.isEmpty() || pixels.size() != numPixels * (int) sizeof(TexturePixel)) {
+         continue;
+      }
+      auto* imageData = new TexturePixel[numPixels];
+      memcpy(imageData, pixels.constData(), pixels.size());
+      TextureImagePtr image(new TextureImage(size, imageData));
+      getNode(idMappings[nodeId])->insertCachedImage(settingsHash, image);
+   }
+   return true;
+}
+
+/**
+ * @brief TextureProject::saveAsBinary
+ * @param includeimages Whether the nodes' cached images should be stored.
+ * @param compressimages Whether the stored images should be compressed.
+ * @return The whole scene including the nodes in the binary format.
+ */
+QByteArray TextureProject::saveAsBinary(bool includeimages, bool compressimages)
+{
+   QByteArray data;
+   QDataStream stream(&data, QIODevice::WriteOnly);
+   stream.setVersion(QDataStream::Qt_5_6);
+   stream << binaryMagic << binaryVersion;
+
+   nodesmutex.lockForRead();
+   QList<TextureNodePtr> nodeList = nodes.values();
+   nodesmutex.unlock();
+   for (const TextureNodePtr& node : nodeList) {
+      QByteArray chunk;
+      QDataStream chunkStream(&chunk, QIODevice::WriteOnly);
+      chunkStream.setVersion(QDataStream::Qt_5_6);
+      node->saveAsBinary(chunkStream);
+      stream << binaryNodeChunk << chunk;
+   }
+   if (includeimages) {
+      for (const TextureNodePtr& node : nodeList) {
+         QByteArray settingsHash = node->getSettingsHash();
+         const QList<TextureImagePtr> images = node->getCachedImages();
+         for (const TextureImagePtr& image : images) {
+            QSize size = image->getSize();
+            QByteArray pixels = QByteArray::fromRawData(
+                     reinterpret_cast<const char*>(image->getData()),
+                     size.width() * size.height() * (int) sizeof(TexturePixel));
+            bool compressed = false;
+            if (compressimages) {
+               QByteArray compressedPixels = qCompress(pixels);
+               if (compressedPixels.size() < pixels.size()) {
+                  pixels = compressedPixels;
+                  compressed = true;
+               }
+            }
+            QByteArray chunk;
+            QDataStream chunkStream(&chunk, QIODevice::WriteOnly);
+            chunkStream.setVersion(QDataStream::Qt_5_6);
+            chunkStream << qint32(node->getId()) << settingsHash << size << compressed << pixels;
+            stream << binaryImageChunk << chunk;
+         }
+      }
+   }
+   modified = false;
+   return data;
+}
+
 /**
  * @brief TextureProject::isModified
  * @return true if the project has been modified since last save or load.
@@ -264,6 +511,18 @@ int TextureProject::getNumNodes() const
    return nodes.count();
 }
 
+/**
+ * @brief TextureProject::getNodeIds
+ * @return the ids of all the nodes in the node graph.
+ */
+QList<int> TextureProject::getNodeIds() const
+{
+   nodesmutex.lockForRead();
+   QList<int> ids = nodes.keys();
+   nodesmutex.unlock();
+   return ids;
+}
+
 /**
  * @brief TextureProject::getNewId
  * @return a valid node id
@@ -423,29 +682,8 @@ void TextureProject::cutNode(int id)
  */
 void TextureProject::pasteNode()
 {
-   QDomDocument copyBuffer;
-   copyBuffer.setContent(QApplication::clipboard()->text());
-   if (copyBuffer.isNull()) {
-      return;
-   }
-   QDomNode rootNode = copyBuffer.namedItem("TextureSet");
-   if (rootNode.isNull()) {
-      return;
-   }
-   QDomNode nodeRoot = rootNode.namedItem("Nodes");
-   if (nodeRoot.isNull()) {
-      return;
-   }
-   QDomNodeList nodes = nodeRoot.childNodes();
-   for (int i = 0; i < nodes.count(); i++) {
-      QDomNode currNode = nodes.at(i);
-      QDomElement generatornode = currNode.namedItem("generator").toElement();
-      TextureNodePtr node = newNode(0, getGenerator(!generatornode.isNull() ?
-                                                     generatornode.attribute("name") : ""));
-      node->loadFromXML(currNode);
-      node->setPos(QPointF(node->getPos().x() + this->nodes.size() * 15,
-                           node->getPos().y() + this->nodes.size() * 15));
-   }
+   QXmlStreamReader xml(QApplication::clipboard()->text());
+   loadFromXML(xml, true);
 }
 
 /**
@@ -8,12 +8,14 @@
 #ifndef TEXTUREPROJECT_H
 #define TEXTUREPROJECT_H
 
+#include "rendercache.h"
 #include "texturenode.h"
 #include <QDomDocument>
 #include <QMap>
 #include <QReadWriteLock>
 #include <QSize>
 #include <QThread>
+#include <QXmlStreamReader>
 
 class TextureRenderThread;
 class TextureGenerator;
@@ -34,7 +36,11 @@ public:
    TextureProject();
    ~TextureProject() override;
    QDomDocument saveAsXML(bool includegenerators = false);
-   void loadFromXML(const QDomDocument& xmlfile);
+   bool loadFromXML(QIODevice* device);
+   static bool isXMLProject(const QByteArray& data);
+   QByteArray saveAsBinary(bool includeimages = true, bool compressimages = true);
+   bool loadFromBinary(const QByteArray& data);
+   static bool isBinaryProject(const QByteArray& data);
    QString getName() const { return name; }
    void setName(const QString&);
    TextureNodePtr getNode(int id) const;
@@ -44,12 +50,14 @@ public:
    void clear();
    bool isModified() const;
    int getNumNodes() const;
+   QList<int> getNodeIds() const;
    TextureGeneratorPtr getGenerator(const QString& name) const;
    QMap<QString, TextureGeneratorPtr> getGenerators() const { return generators; }
    QSize getThumbnailSize() const { return thumbnailSize; }
    QSize getPreviewSize() const { return previewSize; }
    void setSettingsManager(SettingsManager* manager);
    SettingsManager* getSettingsManager() const { return settingsManager; }
+   RenderCache* getRenderCache() { return &renderCache; }
 
 public slots:
    void addGenerator(const TextureGeneratorPtr& gen);
@@ -80,6 +88,7 @@ private:
    void startRenderThread(QSize renderSize, QThread::Priority = QThread::NormalPriority);
    void stopRenderThread(QSize renderSize);
    int getNewId();
+   bool loadFromXML(QXmlStreamReader& xml, bool pasted);
 
    QString name;
    int newIdCounter;
@@ -92,6 +101,7 @@ private:
    QSize thumbnailSize;
    QSize previewSize;
    SettingsManager* settingsManager;
+   RenderCache renderCache;
    bool modified;
 };
 
@@ -0,0 +1,192 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include "parallelbands.h"
+#include "warpsampler.h"
+#include <QStringList>
+#include <cmath>
+
+/**
+ * @brief sourceIndex
+ * @param pos Pixel index, possibly outside the image
+ * @param length Width or height of the image
+ * @param wrap Wrap around the edges instead of clamping
+ * @return Index inside the image
+ */
+static inline int sourceIndex(int pos, int length, bool wrap)
+{
+   if (wrap) {
+      pos %= length;
+      return pos < 0 ? pos + length : pos;
+   }
+   return qBound(0, pos, length - 1);
+}
+
+
+/**
+ * @brief samplePixel
+ *
+ * The filter and edge mode are template parameters so that
+ * WarpSampler::warp() gets a loop without branches on them.
+ */
+template<bool bilinear, bool wrap>
+static inline TexturePixel samplePixel(const TexturePixel* sourceimage, int width, int height,
+                                       float x, float y)
+{
+   if (!bilinear) {
+      int ix = sourceIndex(static_cast<int>(std::floor(x + 0.5f)), width, wrap);
+      int iy = sourceIndex(static_cast<int>(std::floor(y + 0.5f)), height, wrap);
+      return sourceimage[iy * width + ix];
+   }
+   float floorX = std::floor(x);
+   float floorY = std::floor(y);
+   float fracX = x - floorX;
+   float fracY = y - floorY;
+   int x0 = sourceIndex(static_cast<int>(floorX), width, wrap);
+   int y0 = sourceIndex(static_cast<int>(floorY), height, wrap);
+   int x1 = sourceIndex(static_cast<int>(floorX) + 1, width, wrap);
+   int y1 = sourceIndex(static_cast<int>(floorY) + 1, height, wrap);
+   const TexturePixel& p00 = sourceimage[y0 * width + x0];
+   const TexturePixel& p01 = sourceimage[y0 * width + x1];
+   const TexturePixel& p10 = sourceimage[y1 * width + x0];
+   const TexturePixel& p11 = sourceimage[y1 * width + x1];
+   float w00 = (1 - fracX) * (1 - fracY);
+   float w01 = fracX * (1 - fracY);
+   float w10 = (1 - fracX) * fracY;
+   float w11 = fracX * fracY;
+   return TexturePixel(static_cast<unsigned char>(p00.r * w00 + p01.r * w01 + p10.r * w10 + p11.r * w11 + 0.5f),
+                       static_cast<unsigned char>(p00.g * w00 + p01.g * w01 + p10.g * w10 + p11.g * w11 + 0.5f),
+                       static_cast<unsigned char>(p00.b * w00 + p01.b * w01 + p10.b * w10 + p11.b * w11 + 0.5f),
+                       static_cast<unsigned char>(p00.a * w00 + p01.a * w01 + p10.a * w10 + p11.a * w11 + 0.5f));
+}
+
+
+/**
+ * @brief sampleRow
+ */
+template<bool bilinear, bool wrap>
+static void sampleRow(const TexturePixel* sourceimage, int width, int height,
+                      const float* sourceX, const float* sourceY, TexturePixel* destRow)
+{
+   for (int x = 0; x < width; x++) {
+      destRow[x] = samplePixel<bilinear, wrap>(sourceimage, width, height, sourceX[x], sourceY[x]);
+   }
+}
+
+
+/**
+ * @brief WarpSampler::warp
+ * @param size Image size, same for the source and the destination
+ * @param destimage Destination image
+ * @param sourceimage Source image
+ * @param mapper Function computing the source coordinates for a row
+ * @param edges How coordinates outside the source are handled
+ * @param filter How the source is sampled
+ *
+ * The coordinates for a whole row are computed before the row is sampled,
+ * which keeps the mapping functions as simple loops over float arrays.
+ */
+void WarpSampler::warp(QSize size, TexturePixel* destimage, const TexturePixel* sourceimage,
+                       const RowMapper& mapper, Edges edges, Filter filter)
+{
+   int width = size.width();
+   int height = size.height();
+   bool bilinear = filter == Filter::Bilinear;
+   bool wrap = edges == Edges::Wrap;
+   ParallelBands::run(height, [&](int startY, int endY) {
+      auto* sourceX = new float[width];
+      auto* sourceY = new float[width];
+      for (int y = startY; y < endY; y++) {
+         mapper(y, width, sourceX, sourceY);
+         TexturePixel* destRow = destimage + y * width;
+         if (bilinear && wrap) {
+            sampleRow<true, true>(sourceimage, width, height, sourceX, sourceY, destRow);
+         } else if (bilinear) {
+            sampleRow<true, false>(sourceimage, width, height, sourceX, sourceY, destRow);
+         } else if (wrap) {
+            sampleRow<false, true>(sourceimage, width, height, sourceX, sourceY, destRow);
+         } else {
+            sampleRow<false, false>(sourceimage, width, height, sourceX, sourceY, destRow);
+         }
+      }
+      delete[] sourceX;
+      delete[] sourceY;
+   });
+}
+
+
+/**
+ * @brief WarpSampler::sample
+ * @return The source pixel at (x, y)
+ *
+ * Single pixel version of warp(), for filters with their own loops.
+ */
+TexturePixel WarpSampler::sample(const TexturePixel* sourceimage, QSize size,
+                                 float x, float y, Edges edges, Filter filter)
+{
+   int width = size.width();
+   int height = size.height();
+   if (filter == Filter::Bilinear) {
+      if (edges == Edges::Wrap) {
+         return samplePixel<true, true>(sourceimage, width, height, x, y);
+      }
+      return samplePixel<true, false>(sourceimage, width, height, x, y);
+   }
+   if (edges == Edges::Wrap) {
+      return samplePixel<false, true>(sourceimage, width, height, x, y);
+   }
+   return samplePixel<false, false>(sourceimage, width, height, x, y);
+}
+
+
+/**
+ * @brief WarpSampler::addSettings
+ * @param configurables The generator's settings
+ * @param order Order of the first added setting
+ *
+ * Adds the "edges" and "filtering" settings read by getEdges() and getFilter().
+ */
+void WarpSampler::addSettings(TextureGeneratorSettings& configurables, int order)
+{
+   QStringList edgeModes;
+   edgeModes.append("Wrap");
+   edgeModes.append("Clamp");
+   TextureGeneratorSetting edges;
+   edges.name = "Edges";
+   edges.description = "How pixels outside of the image are sampled";
+   edges.defaultvalue = QVariant(edgeModes);
+   edges.order = order;
+   configurables.insert("edges", edges);
+
+   QStringList filterings;
+   filterings.append("Nearest");
+   filterings.append("Bilinear");
+   TextureGeneratorSetting filtering;
+   filtering.name = "Filtering";
+   filtering.description = "How the source image is sampled";
+   filtering.defaultvalue = QVariant(filterings);
+   filtering.order = order + 1;
+   configurables.insert("filtering", filtering);
+}
+
+
+/**
+ * @brief WarpSampler::getEdges
+ */
+WarpSampler::Edges WarpSampler::getEdges(TextureNodeSettings* settings)
+{
+   return settings->value("edges").toString() == "Clamp" ? Edges::Clamp : Edges::Wrap;
+}
+
+
+/**
+ * @brief WarpSampler::getFilter
+ */
+WarpSampler::Filter WarpSampler::getFilter(TextureNodeSettings* settings)
+{
+   return settings->value("filtering").toString() == "Bilinear" ? Filter::Bilinear : Filter::Nearest;
+}
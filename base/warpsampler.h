@@ -0,0 +1,48 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef WARPSAMPLER_H
+#define WARPSAMPLER_H
+
+#include "global.h"
+#include <QSize>
+#include <functional>
+
+/**
+ * @brief The WarpSampler class
+ *
+ * Shared engine for the filters that move pixels around. The filter
+ * supplies a function that maps a row of destination pixels to source
+ * coordinates, and the engine splits the rows over the threads and samples
+ * the source with the chosen edge handling and filtering.
+ *
+ * Coordinates are in pixels with the pixel centers on whole numbers,
+ * so mapping every pixel to itself returns the source unchanged.
+ */
+class WarpSampler
+{
+public:
+   enum class Edges { Wrap, Clamp };
+   enum class Filter { Nearest, Bilinear };
+
+   /**
+    * Fills sourceX and sourceY with the source coordinates of the
+    * width destination pixels on row y.
+    */
+   typedef std::function<void(int y, int width, float* sourceX, float* sourceY)> RowMapper;
+
+   static void warp(QSize size, TexturePixel* destimage, const TexturePixel* sourceimage,
+                    const RowMapper& mapper, Edges edges, Filter filter);
+   static TexturePixel sample(const TexturePixel* sourceimage, QSize size,
+                              float x, float y, Edges edges, Filter filter);
+
+   static void addSettings(TextureGeneratorSettings& configurables, int order);
+   static Edges getEdges(TextureNodeSettings* settings);
+   static Filter getFilter(TextureNodeSettings* settings);
+};
+
+#endif // WARPSAMPLER_H
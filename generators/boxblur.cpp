@@ -37,43 +37,71 @@ void BoxBlurTextureGenerator::generate(QSize size,
    }
    int numNeightboursX = settings->value("numneighbours").toDouble() * qMax(size.width() / 250, 1);
    int numNeightboursY = settings->value("numneighbours").toDouble() * qMax(size.height() / 250, 1);
-   for (int j = 0; j < size.height(); j++) {
-      for (int i = 0; i < size.width(); i++) {
-         int startX = i - numNeightboursX;
-         int endX = i + numNeightboursX;
-         int startY = j - numNeightboursY;
-         int endY = j + numNeightboursY;
-         int totalPixels = 0;
-         quint64 red = 0;
-         quint64 green = 0;
-         quint64 blue = 0;
-         quint64 alpha = 0;
-         for (int ypos = startY; ypos < endY; ypos++) {
-            int currY = ypos;
-            if (currY < 0) {
-               currY += size.height() * 5;
-            }
-            currY %= size.height();
-            currY *= size.width();
-            for (int xpos = startX; xpos < endX; xpos++) {
-               int currX = xpos;
-               if (currX < 0) {
-                  currX += size.width() * 5;
-               }
-               currX %= size.width();
-               totalPixels++;
-               TexturePixel sourcePixel = sourceImage[currY + currX];
-               red += sourcePixel.r;
-               green += sourcePixel.g;
-               blue += sourcePixel.b;
-               alpha += sourcePixel.a;
-            }
+   if (numNeightboursX <= 0 || numNeightboursY <= 0) {
+      memcpy(destimage, sourceImage, size.width() * size.height() * sizeof(TexturePixel));
+      return;
+   }
+   int width = size.width();
+   int height = size.height();
+   int rowLength = width * 4;
+   const auto* src = reinterpret_cast<const unsigned char*>(sourceImage);
+   auto* dst = reinterpret_cast<unsigned char*>(destimage);
+   quint64 totalPixels = static_cast<quint64>(numNeightboursX) * numNeightboursY * 4;
+
+   // Running sums of the rows [j - numNeightboursY, j + numNeightboursY) for each
+   // column and channel. The box wraps around the image edges, so moving down one
+   // row adds one wrapped row and removes another.
+   auto* columnSums = new quint64[rowLength];
+   memset(columnSums, 0, rowLength * sizeof(quint64));
+   for (int ypos = -numNeightboursY; ypos < numNeightboursY; ypos++) {
+      const unsigned char* srcRow = src + (((ypos % height) + height) % height) * rowLength;
+      for (int l = 0; l < rowLength; l++) {
+         columnSums[l] += srcRow[l];
+      }
+   }
+   int addRow = numNeightboursY % height;
+   int removeRow = (height - numNeightboursY % height) % height;
+   int firstAddColumn = numNeightboursX % width;
+   int firstRemoveColumn = (width - numNeightboursX % width) % width;
+
+   for (int j = 0; j < height; j++) {
+      // Same running sum horizontally over the column sums.
+      quint64 sum[4] = { 0, 0, 0, 0 };
+      for (int xpos = -numNeightboursX; xpos < numNeightboursX; xpos++) {
+         const quint64* column = columnSums + (((xpos % width) + width) % width) * 4;
+         sum[0] += column[0];
+         sum[1] += column[1];
+         sum[2] += column[2];
+         sum[3] += column[3];
+      }
+      int addColumn = firstAddColumn;
+      int removeColumn = firstRemoveColumn;
+      unsigned char* dstRow = dst + j * rowLength;
+      for (int i = 0; i < width; i++) {
+         for (int c = 0; c < 4; c++) {
+            dstRow[i * 4 + c] = static_cast<unsigned char>(sum[c] / totalPixels);
+            sum[c] += columnSums[addColumn * 4 + c];
+            sum[c] -= columnSums[removeColumn * 4 + c];
+         }
+         if (++addColumn == width) {
+            addColumn = 0;
+         }
+         if (++removeColumn == width) {
+            removeColumn = 0;
          }
-         int pixelpos = j * size.width() + i;
-         destimage[pixelpos].r = static_cast<unsigned char>(red / totalPixels);
-         destimage[pixelpos].g = static_cast<unsigned char>(green / totalPixels);
-         destimage[pixelpos].b = static_cast<unsigned char>(blue / totalPixels);
-         destimage[pixelpos].a = static_cast<unsigned char>(alpha / totalPixels);
+      }
+      const unsigned char* addSrc = src + addRow * rowLength;
+      const unsigned char* removeSrc = src + removeRow * rowLength;
+      for (int l = 0; l < rowLength; l++) {
+         columnSums[l] += addSrc[l];
+         columnSums[l] -= removeSrc[l];
+      }
+      if (++addRow == height) {
+         addRow = 0;
+      }
+      if (++removeRow == height) {
+         removeRow = 0;
       }
    }
+   delete[] columnSums;
 }
@@ -5,9 +5,10 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/shaperasterizer.h"
 #include "bricks.h"
 #include <QColor>
-#include <QPainter>
+#include <cmath>
 
 BricksTextureGenerator::BricksTextureGenerator()
 {
@@ -82,33 +83,30 @@ void BricksTextureGenerator::generate(QSize size,
       memset(destimage, 0, size.width() * size.height() * sizeof(TexturePixel));
    }
 
-   bool invert = false;
-   QVector<QLine> lines;
+   if (linewidth <= 0) {
+      return;
+   }
+   // The horizontal lines are rowHeight apart. Each row has vertical lines
+   // columnWidth apart, shifted half a brick on every other row. A vertical
+   // line runs from its row's horizontal line to the next one.
+   float rowHeight = brickheight + linewidth;
+   float columnWidth = brickwidth + linewidth;
+   float halfLine = linewidth / 2.0f;
+   float startY = offsety - size.height() - brickheight / 2;
+   float startX = offsetx - size.width() - brickwidth / 2;
 
-   int currY = offsety - size.height() - brickheight / 2;
-   while (currY < (size.height() + linewidth / 2)) {
-      if (currY > (-linewidth / 2) && currY < (size.height() + linewidth)) {
-         lines.append(QLine(0, currY, size.width(), currY));
-      }
-      invert = !invert;
-      int currX = offsetx - size.width() - brickwidth / 2;
-      if (invert) {
-         currX += brickwidth / 2;
+   ShapeRasterizer::fill(size, QRect(QPoint(0, 0), size), destimage, color,
+                         [=](int y, int firstX, int count, float* coverage) {
+      float nearestRow = std::floor((y + 0.5f - startY) / rowHeight + 0.5f);
+      float lineY = startY + nearestRow * rowHeight;
+      float horizontal = ShapeRasterizer::spanCoverage(y, lineY - halfLine, lineY + halfLine);
+      auto row = static_cast<int>(std::floor((y + 0.5f - startY) / rowHeight));
+      float rowStartX = startX + (((row & 1) == 0) ? brickwidth / 2 : 0);
+      for (int i = 0; i < count; i++) {
+         float x = firstX + i;
+         float lineX = rowStartX + std::floor((x + 0.5f - rowStartX) / columnWidth + 0.5f) * columnWidth;
+         float vertical = ShapeRasterizer::spanCoverage(x, lineX - halfLine, lineX + halfLine);
+         coverage[i] = qMax(horizontal, vertical);
       }
-      while (currX < (size.width() + linewidth / 2)) {
-         if (currX > (-linewidth / 2) && currX < (size.width() + linewidth)) {
-            lines.append(QLine(currX, currY, currX, currY + brickheight + linewidth));
-         }
-         currX += brickwidth + linewidth;
-      }
-      currY += brickheight + linewidth;
-   }
-   QImage tempimage = QImage(size.width(), size.height(), QImage::Format_RGB32);
-   memcpy(tempimage.bits(), destimage, size.width() * size.height() * sizeof(TexturePixel));
-   QPainter painter(&tempimage);
-   painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-   painter.setBrush(QBrush(color, Qt::BrushStyle::SolidPattern));
-   painter.setPen(QPen(color, linewidth, Qt::SolidLine, Qt::FlatCap, Qt::BevelJoin));
-   painter.drawLines(lines);
-   memcpy(destimage, tempimage.bits(), size.width() * size.height() * sizeof(TexturePixel));
+   });
 }
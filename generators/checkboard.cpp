@@ -5,9 +5,10 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/shaperasterizer.h"
 #include "checkboard.h"
 #include <QColor>
-#include <QPainter>
+#include <cmath>
 
 CheckboardTextureGenerator::CheckboardTextureGenerator()
 {
@@ -70,26 +71,21 @@ void CheckboardTextureGenerator::generate(QSize size,
    } else {
       memset(destimage, 0, size.width() * size.height() * sizeof(TexturePixel));
    }
-   QImage tempimage = QImage(size.width(), size.height(), QImage::Format_RGB32);
-   memcpy(tempimage.bits(), destimage, size.width() * size.height() * sizeof(TexturePixel));
-   QPainter painter(&tempimage);
-   painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-   painter.setBrush(QBrush(color, Qt::BrushStyle::SolidPattern));
-   painter.setPen(Qt::NoPen);
 
-   bool invert = false;
-   int currY = offsety - size.height() - brickheight;
-   while (currY < size.height()) {
-      invert = !invert;
-      int currX = offsetx - size.width() - brickwidth;
-      if (invert) {
-         currX += brickwidth;
-      }
-      while (currX < size.width()) {
-         painter.drawRect(currX, currY, brickwidth, brickheight);
-         currX += brickwidth * 2;
-      }
-      currY += brickheight;
+   if (brickwidth <= 0 || brickheight <= 0) {
+      return;
    }
-   memcpy(destimage, tempimage.bits(), size.width() * size.height() * sizeof(TexturePixel));
+   // The first row's filled squares start at startX, and every other
+   // row is shifted one square, so squares with an even row + column
+   // are filled.
+   int startX = offsetx - size.width();
+   int startY = offsety - size.height() - brickheight;
+   ShapeRasterizer::fill(size, QRect(QPoint(0, 0), size), destimage, color,
+                         [=](int y, int firstX, int count, float* coverage) {
+      auto row = static_cast<int>(std::floor((float) (y - startY) / brickheight));
+      for (int i = 0; i < count; i++) {
+         auto column = static_cast<int>(std::floor((float) (firstX + i - startX) / brickwidth));
+         coverage[i] = ((row + column) & 1) == 0 ? 1 : 0;
+      }
+   });
 }
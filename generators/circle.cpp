@@ -5,6 +5,7 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/shaperasterizer.h"
 #include "circle.h"
 #include <QColor>
 #include <cmath>
@@ -65,37 +66,30 @@ void CircleTextureGenerator::generate(QSize size,
       return;
    }
    QColor color = settings->value("color").value<QColor>();
-   double innerRadius = settings->value("innerradius").toDouble() * size.height() / 200.0;
-   double outerRadius = settings->value("outerradius").toDouble() * size.height() / 200.0;
+   float innerRadius = settings->value("innerradius").toDouble() * size.height() / 200.0;
+   float outerRadius = settings->value("outerradius").toDouble() * size.height() / 200.0;
    int offsetLeft = settings->value("offsetleft").toDouble() * size.width() / 100;
    int offsetTop = settings->value("offsettop").toDouble() * size.height() / 100;
 
-   bool blend = false;
    if (sourceimages.contains(0)) {
       memcpy(destimage, sourceimages.value(0)->getData(), size.width() * size.height() * sizeof(TexturePixel));
-      blend = true;
    } else {
       memset(destimage, 0, size.width() * size.height() * sizeof(TexturePixel));
    }
-   if (color.alpha() == 255) {
-      blend = false;
-   }
-   double alpha = color.alphaF();
-   double srcAlpha = 1 - alpha;
-   for (int y = 0; y < size.height(); y++) {
-      for (int x = 0; x < size.width(); x++) {
-         if (((pow(abs(size.width() / 2 - x + offsetLeft), 2)
-               + pow(abs(size.height() / 2 - y + offsetTop), 2))
-              >= (pow(innerRadius, 2))) &&
-             ((pow(abs(size.width() / 2 - x + offsetLeft), 2)
-               + pow(abs(size.height() / 2 - y + offsetTop), 2))
-              <= (pow(outerRadius, 2)))) {
-            int thisPos = y * size.width() + x;
-            destimage[thisPos].r = static_cast<quint8>(alpha * color.red() + (blend ? (srcAlpha * destimage[thisPos].r) : 0));
-            destimage[thisPos].g = static_cast<quint8>(alpha * color.green() + (blend ? (srcAlpha * destimage[thisPos].g) : 0));
-            destimage[thisPos].b = static_cast<quint8>(alpha * color.blue() + (blend ? (srcAlpha * destimage[thisPos].b) : 0));
-            destimage[thisPos].a = static_cast<quint8>(color.alpha() + (blend ? (srcAlpha * destimage[thisPos].a) : 0));
+
+   float centerX = size.width() / 2 + offsetLeft;
+   float centerY = size.height() / 2 + offsetTop;
+   ShapeRasterizer::fill(size, QRect(QPoint(0, 0), size), destimage, color,
+                         [=](int y, int startX, int count, float* coverage) {
+      float dy = y - centerY;
+      for (int i = 0; i < count; i++) {
+         float dx = startX + i - centerX;
+         float distance = std::sqrt(dx * dx + dy * dy);
+         float shape = ShapeRasterizer::edgeCoverage(distance - outerRadius, true);
+         if (innerRadius > 0 && shape > 0) {
+            shape *= 1 - ShapeRasterizer::edgeCoverage(distance - innerRadius, true);
          }
+         coverage[i] = shape;
       }
-   }
+   });
 }
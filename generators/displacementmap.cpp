@@ -7,6 +7,7 @@
 
 #include <cmath>
 #include <QtMath>
+#include "base/warpsampler.h"
 #include "displacementmap.h"
 
 using namespace std;
@@ -37,6 +38,7 @@ DisplacementMapTextureGenerator::DisplacementMapTextureGenerator()
    offset.order = 4;
    configurables.insert("offset", offset);
 
+   WarpSampler::addSettings(configurables, 5);
 }
 
 
@@ -64,20 +66,17 @@ void DisplacementMapTextureGenerator::generate(QSize size,
    double angle = settings->value("angle").toDouble();
    angle = (angle / 180.0) * ((double) M_PI);
 
-   for (int y = 0; y < size.height(); y++) {
-      for (int x = 0; x < size.width(); x++) {
-         double srcDistance = sourceMap[y * size.width() + x].intensityWithAlpha();
-         srcDistance *= strength;
-         srcDistance -= offset;
-         int xpos = x + srcDistance * sin(angle);
-         int ypos = y - srcDistance * cos(angle);
-         xpos = xpos > size.height() ? xpos % size.height() :
-                                       (xpos < 0 ? xpos + size.width() : xpos);
-         ypos = ypos > size.height() ? ypos % size.height() :
-                                       (ypos < 0 ? ypos + size.height() : ypos);
-         xpos = qMax(qMin(xpos, size.width() - 1), 0);
-         ypos = qMax(qMin(ypos, size.height() - 1), 0);
-         destimage[y * size.width() + x] = sourceImage[ypos * size.width() + xpos];
+   float displaceX = sin(angle);
+   float displaceY = -cos(angle);
+   float mapStrength = strength;
+   float mapOffset = offset;
+
+   WarpSampler::warp(size, destimage, sourceImage, [=](int y, int width, float* sourceX, float* sourceY) {
+      const TexturePixel* mapRow = sourceMap + y * width;
+      for (int x = 0; x < width; x++) {
+         float srcDistance = mapRow[x].intensityWithAlpha() * mapStrength - mapOffset;
+         sourceX[x] = x + srcDistance * displaceX;
+         sourceY[x] = y + srcDistance * displaceY;
       }
-   }
+   }, WarpSampler::getEdges(settings), WarpSampler::getFilter(settings));
 }
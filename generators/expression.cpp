@@ -0,0 +1,609 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include "base/parallelbands.h"
+#include "expression.h"
+#include <QDebug>
+#include <QMutexLocker>
+#include <QtMath>
+#include <cmath>
+
+typedef ExpressionTextureGenerator::Op Op;
+
+/**
+ * Indices of the values in the uniforms array.
+ */
+enum Uniform { UniformP1, UniformP2, UniformP3, UniformWidth, UniformHeight, NumUniforms };
+
+/**
+ * The functions that can be called from an expression.
+ */
+static const struct {
+   const char* name;
+   Op op;
+   int arity;
+} functions[] = {
+   { "sin", Op::Sin, 1 }, { "cos", Op::Cos, 1 }, { "tan", Op::Tan, 1 },
+   { "asin", Op::Asin, 1 }, { "acos", Op::Acos, 1 }, { "atan", Op::Atan, 1 },
+   { "sqrt", Op::Sqrt, 1 }, { "abs", Op::Abs, 1 }, { "floor", Op::Floor, 1 },
+   { "ceil", Op::Ceil, 1 }, { "fract", Op::Fract, 1 }, { "exp", Op::Exp, 1 },
+   { "log", Op::Log, 1 }, { "pow", Op::Pow, 2 }, { "mod", Op::Mod, 2 },
+   { "min", Op::Min, 2 }, { "max", Op::Max, 2 }, { "atan2", Op::Atan2, 2 },
+   { "step", Op::Step, 2 }, { "clamp", Op::Clamp, 3 }, { "mix", Op::Mix, 3 }
+};
+
+/**
+ * @brief The ExpressionCompiler class
+ *
+ * Recursive descent parser that emits the instructions for an expression
+ * while parsing it. Every instruction writes a new register, so the
+ * registers never have to be tracked for reuse.
+ *
+ *    comparison := additive [("<" | ">" | "<=" | ">=" | "==" | "!=") additive]
+ *    additive   := term {("+" | "-") term}
+ *    term       := unary {("*" | "/" | "%") unary}
+ *    unary      := ("-" | "+") unary | power
+ *    power      := primary ["^" unary]
+ *    primary    := number | name | name "(" arguments ")" | "(" comparison ")"
+ */
+class ExpressionCompiler
+{
+public:
+   explicit ExpressionCompiler(ExpressionTextureGenerator::Program* program)
+      : program(program) {}
+   int compile(const QString& expression, QString* error);
+
+private:
+   int parseComparison();
+   int parseAdditive();
+   int parseTerm();
+   int parseUnary();
+   int parsePower();
+   int parsePrimary();
+   int emit(Op op, int a = -1, int b = -1, int c = -1, float value = 0);
+   int fail(const QString& message);
+   bool accept(const QString& token);
+   void skipSpaces();
+
+   ExpressionTextureGenerator::Program* program;
+   QString text;
+   QString error;
+   int pos = 0;
+};
+
+/**
+ * @brief ExpressionCompiler::compile
+ * @param expression The expression's text
+ * @param error Set to a description of the error if the parsing fails
+ * @return The register with the expression's value, or -1 on errors
+ */
+int ExpressionCompiler::compile(const QString& expression, QString* error)
+{
+   text = expression;
+   pos = 0;
+   this->error.clear();
+   int result = parseComparison();
+   skipSpaces();
+   if (this->error.isEmpty() && pos < text.length()) {
+      fail(QString("Unexpected '%1'").arg(text.at(pos)));
+   }
+   if (!this->error.isEmpty()) {
+      *error = this->error;
+      return -1;
+   }
+   return result;
+}
+
+int ExpressionCompiler::parseComparison()
+{
+   int left = parseAdditive();
+   static const struct { const char* token; Op op; } comparisons[] = {
+      { "<=", Op::LessEqual }, { ">=", Op::GreaterEqual }, { "==", Op::Equal },
+      { "!=", Op::NotEqual }, { "<", Op::Less }, { ">", Op::Greater }
+   };
+   for (const auto& comparison : comparisons) {
+      if (accept(comparison.token)) {
+         return emit(comparison.op, left, parseAdditive());
+      }
+   }
+   return left;
+}
+
+int ExpressionCompiler::parseAdditive()
+{
+   int left = parseTerm();
+   while (error.isEmpty()) {
+      if (accept("+")) {
+         left = emit(Op::Add, left, parseTerm());
+      } else if (accept("-")) {
+         left = emit(Op::Sub, left, parseTerm());
+      } else {
+         break;
+      }
+   }
+   return left;
+}
+
+int ExpressionCompiler::parseTerm()
+{
+   int left = parseUnary();
+   while (error.isEmpty()) {
+      if (accept("*")) {
+         left = emit(Op::Mul, left, parseUnary());
+      } else if (accept("/")) {
+         left = emit(Op::Div, left, parseUnary());
+      } else if (accept("%")) {
+         left = emit(Op::Mod, left, parseUnary());
+      } else {
+         break;
+      }
+   }
+   return left;
+}
+
+int ExpressionCompiler::parseUnary()
+{
+   if (accept("-")) {
+      return emit(Op::Neg, parseUnary());
+   }
+   if (accept("+")) {
+      return parseUnary();
+   }
+   return parsePower();
+}
+
+int ExpressionCompiler::parsePower()
+{
+   int base = parsePrimary();
+   if (accept("^")) {
+      return emit(Op::Pow, base, parseUnary());
+   }
+   return base;
+}
+
+int ExpressionCompiler::parsePrimary()
+{
+   skipSpaces();
+   if (!error.isEmpty()) {
+      return -1;
+   }
+   if (pos >= text.length()) {
+      return fail("Unexpected end of expression");
+   }
+   if (accept("(")) {
+      int value = parseComparison();
+      if (!accept(")")) {
+         return fail("Missing ')'");
+      }
+      return value;
+   }
+   QChar first = text.at(pos);
+   if (first.isDigit() || first == '.') {
+      int start = pos;
+      while (pos < text.length() && (text.at(pos).isDigit() || text.at(pos) == '.')) {
+         pos++;
+      }
+      if (pos < text.length() && (text.at(pos) == 'e' || text.at(pos) == 'E')) {
+         int exponent = pos + 1;
+         if (exponent < text.length() && (text.at(exponent) == '+' || text.at(exponent) == '-')) {
+            exponent++;
+         }
+         if (exponent < text.length() && text.at(exponent).isDigit()) {
+            pos = exponent;
+            while (pos < text.length() && text.at(pos).isDigit()) {
+               pos++;
+            }
+         }
+      }
+      bool ok = false;
+      float value = text.mid(start, pos - start).toFloat(&ok);
+      if (!ok) {
+         return fail(QString("Invalid number '%1'").arg(text.mid(start, pos - start)));
+      }
+      return emit(Op::Const, -1, -1, -1, value);
+   }
+   if (!first.isLetter() && first != '_') {
+      return fail(QString("Unexpected '%1'").arg(first));
+   }
+   int start = pos;
+   while (pos < text.length() && (text.at(pos).isLetterOrNumber() || text.at(pos) == '_')) {
+      pos++;
+   }
+   QString name = text.mid(start, pos - start);
+
+   if (accept("(")) {
+      QVector<int> arguments;
+      if (!accept(")")) {
+         do {
+            arguments.append(parseComparison());
+         } while (error.isEmpty() && accept(","));
+         if (!accept(")")) {
+            return fail(QString("Missing ')' after the arguments to %1").arg(name));
+         }
+      }
+      for (const auto& function : functions) {
+         if (name == function.name) {
+            if (arguments.size() != function.arity) {
+               return fail(QString("%1 takes %2 arguments").arg(name).arg(function.arity));
+            }
+            arguments.resize(3);
+            return emit(function.op, arguments[0], arguments[1], arguments[2]);
+         }
+      }
+      return fail(QString("Unknown function '%1'").arg(name));
+   }
+
+   if (name == "x") {
+      return ExpressionTextureGenerator::InputX;
+   } else if (name == "y") {
+      return ExpressionTextureGenerator::InputY;
+   } else if (name == "r" || name == "g" || name == "b" || name == "a") {
+      program->usesSource = true;
+      return name == "r" ? ExpressionTextureGenerator::InputR :
+             name == "g" ? ExpressionTextureGenerator::InputG :
+             name == "b" ? ExpressionTextureGenerator::InputB : ExpressionTextureGenerator::InputA;
+   } else if (name == "p1") {
+      return emit(Op::Uniform, UniformP1);
+   } else if (name == "p2") {
+      return emit(Op::Uniform, UniformP2);
+   } else if (name == "p3") {
+      return emit(Op::Uniform, UniformP3);
+   } else if (name == "width") {
+      return emit(Op::Uniform, UniformWidth);
+   } else if (name == "height") {
+      return emit(Op::Uniform, UniformHeight);
+   } else if (name == "pi") {
+      return emit(Op::Const, -1, -1, -1, (float) M_PI);
+   } else if (name == "e") {
+      return emit(Op::Const, -1, -1, -1, (float) M_E);
+   }
+   return fail(QString("Unknown variable '%1'").arg(name));
+}
+
+/**
+ * @brief ExpressionCompiler::emit
+ * @return The register the new instruction writes to
+ */
+int ExpressionCompiler::emit(Op op, int a, int b, int c, float value)
+{
+   if (!error.isEmpty()) {
+      return -1;
+   }
+   ExpressionTextureGenerator::Instruction instruction;
+   instruction.op = op;
+   instruction.dst = program->numRegisters++;
+   instruction.a = a;
+   instruction.b = b;
+   instruction.c = c;
+   instruction.value = value;
+   program->code.append(instruction);
+   return instruction.dst;
+}
+
+int ExpressionCompiler::fail(const QString& message)
+{
+   if (error.isEmpty()) {
+      error = QString("%1 at position %2").arg(message).arg(pos + 1);
+   }
+   return -1;
+}
+
+bool ExpressionCompiler::accept(const QString& token)
+{
+   skipSpaces();
+   if (error.isEmpty() && text.midRef(pos, token.length()) == token) {
+      pos += token.length();
+      return true;
+   }
+   return false;
+}
+
+void ExpressionCompiler::skipSpaces()
+{
+   while (pos < text.length() && text.at(pos).isSpace()) {
+      pos++;
+   }
+}
+
+
+ExpressionTextureGenerator::ExpressionTextureGenerator()
+{
+   TextureGeneratorSetting red;
+   red.name = "Red";
+   red.description = "Expression for the red channel, from 0 to 1";
+   red.defaultvalue = QVariant(QString("x"));
+   red.order = 1;
+   configurables.insert("red", red);
+
+   TextureGeneratorSetting green;
+   green.name = "Green";
+   green.description = "Expression for the green channel, from 0 to 1";
+   green.defaultvalue = QVariant(QString("y"));
+   green.order = 2;
+   configurables.insert("green", green);
+
+   TextureGeneratorSetting blue;
+   blue.name = "Blue";
+   blue.description = "Expression for the blue channel, from 0 to 1";
+   blue.defaultvalue = QVariant(QString("0.5 + 0.5 * sin((x + y) * p1 * 10)"));
+   blue.order = 3;
+   configurables.insert("blue", blue);
+
+   TextureGeneratorSetting alpha;
+   alpha.name = "Alpha";
+   alpha.description = "Expression for the alpha channel, from 0 to 1";
+   alpha.defaultvalue = QVariant(QString("1"));
+   alpha.order = 4;
+   configurables.insert("alpha", alpha);
+
+   TextureGeneratorSetting p1;
+   p1.name = "p1";
+   p1.defaultvalue = QVariant((double) 1);
+   p1.min = QVariant(-100);
+   p1.max = QVariant(100);
+   p1.order = 5;
+   configurables.insert("p1", p1);
+
+   TextureGeneratorSetting p2;
+   p2.name = "p2";
+   p2.defaultvalue = QVariant((double) 1);
+   p2.min = QVariant(-100);
+   p2.max = QVariant(100);
+   p2.order = 6;
+   configurables.insert("p2", p2);
+
+   TextureGeneratorSetting p3;
+   p3.name = "p3";
+   p3.defaultvalue = QVariant((double) 1);
+   p3.min = QVariant(-100);
+   p3.max = QVariant(100);
+   p3.order = 7;
+   configurables.insert("p3", p3);
+
+   programcache.setMaxCost(64);
+}
+
+
+/**
+ * @brief ExpressionTextureGenerator::compile
+ * @param expressions The red, green, blue and alpha expressions
+ * @param error Set to a description of the first error found
+ * @return The compiled program, or null if an expression is invalid
+ */
+QSharedPointer<const ExpressionTextureGenerator::Program>
+ExpressionTextureGenerator::compile(const QStringList& expressions, QString* error)
+{
+   QSharedPointer<Program> program(new Program);
+   program->numRegisters = NumInputs;
+   ExpressionCompiler compiler(program.data());
+   for (int channel = 0; channel < 4; channel++) {
+      int output = compiler.compile(expressions.value(channel), error);
+      if (output < 0) {
+         *error = QString("Channel %1: %2").arg(channel + 1).arg(*error);
+         return QSharedPointer<const Program>();
+      }
+      program->outputs[channel] = output;
+   }
+   return program;
+}
+
+
+/**
+ * @brief ExpressionTextureGenerator::run
+ * @param program The program to run
+ * @param uniforms Values of the uniforms
+ * @param registers The registers, each width floats, with the inputs set
+ * @param width Number of pixels in each register
+ *
+ * Runs the program's instructions, each over the entire row.
+ */
+void ExpressionTextureGenerator::run(const Program& program, const float* uniforms,
+                                     float** registers, int width) const
+{
+   for (const Instruction& instruction : program.code) {
+      float* dst = registers[instruction.dst];
+      const float* a = instruction.a >= 0 ? registers[instruction.a] : nullptr;
+      const float* b = instruction.b >= 0 ? registers[instruction.b] : nullptr;
+      const float* c = instruction.c >= 0 ? registers[instruction.c] : nullptr;
+      switch (instruction.op) {
+      case Op::Const:
+         std::fill(dst, dst + width, instruction.value);
+         break;
+      case Op::Uniform:
+         std::fill(dst, dst + width, uniforms[instruction.a]);
+         break;
+      case Op::Neg:
+         for (int x = 0; x < width; x++) dst[x] = -a[x];
+         break;
+      case Op::Add:
+         for (int x = 0; x < width; x++) dst[x] = a[x] + b[x];
+         break;
+      case Op::Sub:
+         for (int x = 0; x < width; x++) dst[x] = a[x] - b[x];
+         break;
+      case Op::Mul:
+         for (int x = 0; x < width; x++) dst[x] = a[x] * b[x];
+         break;
+      case Op::Div:
+         for (int x = 0; x < width; x++) dst[x] = a[x] / b[x];
+         break;
+      case Op::Mod:
+         for (int x = 0; x < width; x++) dst[x] = a[x] - b[x] * std::floor(a[x] / b[x]);
+         break;
+      case Op::Pow:
+         for (int x = 0; x < width; x++) dst[x] = std::pow(a[x], b[x]);
+         break;
+      case Op::Less:
+         for (int x = 0; x < width; x++) dst[x] = a[x] < b[x] ? 1 : 0;
+         break;
+      case Op::Greater:
+         for (int x = 0; x < width; x++) dst[x] = a[x] > b[x] ? 1 : 0;
+         break;
+      case Op::LessEqual:
+         for (int x = 0; x < width; x++) dst[x] = a[x] <= b[x] ? 1 : 0;
+         break;
+      case Op::GreaterEqual:
+         for (int x = 0; x < width; x++) dst[x] = a[x] >= b[x] ? 1 : 0;
+         break;
+      case Op::Equal:
+         for (int x = 0; x < width; x++) dst[x] = a[x] == b[x] ? 1 : 0;
+         break;
+      case Op::NotEqual:
+         for (int x = 0; x < width; x++) dst[x] = a[x] != b[x] ? 1 : 0;
+         break;
+      case Op::Min:
+         for (int x = 0; x < width; x++) dst[x] = a[x] < b[x] ? a[x] : b[x];
+         break;
+      case Op::Max:
+         for (int x = 0; x < width; x++) dst[x] = a[x] > b[x] ? a[x] : b[x];
+         break;
+      case Op::Atan2:
+         for (int x = 0; x < width; x++) dst[x] = std::atan2(a[x], b[x]);
+         break;
+      case Op::Step:
+         for (int x = 0; x < width; x++) dst[x] = b[x] < a[x] ? 0 : 1;
+         break;
+      case Op::Sin:
+         for (int x = 0; x < width; x++) dst[x] = std::sin(a[x]);
+         break;
+      case Op::Cos:
+         for (int x = 0; x < width; x++) dst[x] = std::cos(a[x]);
+         break;
+      case Op::Tan:
+         for (int x = 0; x < width; x++) dst[x] = std::tan(a[x]);
+         break;
+      case Op::Asin:
+         for (int x = 0; x < width; x++) dst[x] = std::asin(a[x]);
+         break;
+      case Op::Acos:
+         for (int x = 0; x < width; x++) dst[x] = std::acos(a[x]);
+         break;
+      case Op::Atan:
+         for (int x = 0; x < width; x++) dst[x] = std::atan(a[x]);
+         break;
+      case Op::Sqrt:
+         for (int x = 0; x < width; x++) dst[x] = std::sqrt(a[x]);
+         break;
+      case Op::Abs:
+         for (int x = 0; x < width; x++) dst[x] = std::fabs(a[x]);
+         break;
+      case Op::Floor:
+         for (int x = 0; x < width; x++) dst[x] = std::floor(a[x]);
+         break;
+      case Op::Ceil:
+         for (int x = 0; x < width; x++) dst[x] = std::ceil(a[x]);
+         break;
+      case Op::Fract:
+         for (int x = 0; x < width; x++) dst[x] = a[x] - std::floor(a[x]);
+         break;
+      case Op::Exp:
+         for (int x = 0; x < width; x++) dst[x] = std::exp(a[x]);
+         break;
+      case Op::Log:
+         for (int x = 0; x < width; x++) dst[x] = std::log(a[x]);
+         break;
+      case Op::Clamp:
+         for (int x = 0; x < width; x++) dst[x] = a[x] < b[x] ? b[x] : (a[x] > c[x] ? c[x] : a[x]);
+         break;
+      case Op::Mix:
+         for (int x = 0; x < width; x++) dst[x] = a[x] + (b[x] - a[x]) * c[x];
+         break;
+      }
+   }
+}
+
+
+/**
+ * @brief ExpressionTextureGenerator::generate
+ *
+ * The expressions are only compiled when they have changed. The program
+ * is immutable, and every thread runs it on its own band of rows with
+ * its own registers.
+ */
+void ExpressionTextureGenerator::generate(QSize size,
+                                          TexturePixel* destimage,
+                                          QMap<int, TextureImagePtr> sourceimages,
+                                          TextureNodeSettings* settings) const
+{
+   if (!settings || !destimage || !size.isValid()) {
+      return;
+   }
+   QStringList expressions;
+   expressions.append(settings->value("red").toString());
+   expressions.append(settings->value("green").toString());
+   expressions.append(settings->value("blue").toString());
+   expressions.append(settings->value("alpha").toString());
+   float uniforms[NumUniforms];
+   uniforms[UniformP1] = settings->value("p1").toDouble();
+   uniforms[UniformP2] = settings->value("p2").toDouble();
+   uniforms[UniformP3] = settings->value("p3").toDouble();
+   uniforms[UniformWidth] = size.width();
+   uniforms[UniformHeight] = size.height();
+
+   QString key = expressions.join('\n');
+   QSharedPointer<const Program> program;
+   {
+      QMutexLocker locker(&programmutex);
+      if (QSharedPointer<const Program>* cached = programcache.object(key)) {
+         program = *cached;
+      }
+   }
+   if (program.isNull()) {
+      QString error;
+      program = compile(expressions, &error);
+      if (program.isNull()) {
+         qDebug() << "Expression error: " << error;
+         memset(destimage, 0, size.width() * size.height() * sizeof(TexturePixel));
+         return;
+      }
+      QMutexLocker locker(&programmutex);
+      programcache.insert(key, new QSharedPointer<const Program>(program));
+   }
+
+   int width = size.width();
+   const TexturePixel* source = nullptr;
+   if (sourceimages.contains(0)) {
+      source = sourceimages.value(0)->getData();
+   }
+   ParallelBands::run(size.height(), [&](int startY, int endY) {
+      QVector<float> storage(program->numRegisters * width);
+      QVector<float*> registers(program->numRegisters);
+      for (int i = 0; i < program->numRegisters; i++) {
+         registers[i] = storage.data() + i * width;
+      }
+      for (int x = 0; x < width; x++) {
+         registers[InputX][x] = (x + 0.5f) / width;
+      }
+      for (int y = startY; y < endY; y++) {
+         std::fill(registers[InputY], registers[InputY] + width, (y + 0.5f) / size.height());
+         if (program->usesSource && source) {
+            const TexturePixel* sourceRow = source + y * width;
+            for (int x = 0; x < width; x++) {
+               registers[InputR][x] = sourceRow[x].r / 255.0f;
+               registers[InputG][x] = sourceRow[x].g / 255.0f;
+               registers[InputB][x] = sourceRow[x].b / 255.0f;
+               registers[InputA][x] = sourceRow[x].a / 255.0f;
+            }
+         }
+         run(*program, uniforms, registers.data(), width);
+
+         const float* red = registers[program->outputs[0]];
+         const float* green = registers[program->outputs[1]];
+         const float* blue = registers[program->outputs[2]];
+         const float* alpha = registers[program->outputs[3]];
+         TexturePixel* destRow = destimage + y * width;
+         for (int x = 0; x < width; x++) {
+            // NaN fails both comparisons and becomes 0.
+            auto toChannel = [](float value) {
+               return static_cast<unsigned char>(value > 0 ? (value < 1 ? value * 255 + 0.5f : 255) : 0);
+            };
+            destRow[x] = TexturePixel(toChannel(red[x]), toChannel(green[x]),
+                                      toChannel(blue[x]), toChannel(alpha[x]));
+         }
+      }
+   });
+}
@@ -0,0 +1,90 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef EXPRESSIONTEXTUREGENERATOR_H
+#define EXPRESSIONTEXTUREGENERATOR_H
+
+#include "texturegenerator.h"
+#include <QCache>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief The ExpressionTextureGenerator class
+ *
+ * Computes each color channel from a math expression over the pixel's
+ * position, the source image's channels and three parameters. The
+ * expressions are compiled to bytecode for a register machine where
+ * every register holds a whole row of pixels, so each instruction is
+ * one simple loop over the row.
+ */
+class ExpressionTextureGenerator : public TextureGenerator
+{
+public:
+   ExpressionTextureGenerator();
+   ~ExpressionTextureGenerator() override = default;
+   void generate(QSize size,
+                 TexturePixel* destimage,
+                 QMap<int, TextureImagePtr> sourceimages,
+                 TextureNodeSettings* settings) const override;
+   int getNumSourceSlots() const override { return 1; }
+   QString getName() const override { return QString("Expression"); }
+   const TextureGeneratorSettings& getSettings() const override { return configurables; }
+   QString getDescription() const override {
+      return QString("Computes the channels from expressions, 0 to 1, with the variables "
+                     "x, y, r, g, b, a, p1, p2, p3, width and height.");
+   }
+   TextureGenerator::Type getType() const override { return TextureGenerator::Type::Generator; }
+
+   enum class Op {
+      Const, Uniform, Neg, Add, Sub, Mul, Div, Mod, Pow,
+      Less, Greater, LessEqual, GreaterEqual, Equal, NotEqual,
+      Min, Max, Atan2, Step,
+      Sin, Cos, Tan, Asin, Acos, Atan, Sqrt, Abs, Floor, Ceil, Fract, Exp, Log,
+      Clamp, Mix
+   };
+
+   /**
+    * One instruction, reading registers a, b and c and writing dst.
+    * Const uses value, Uniform uses a as the uniform's index.
+    */
+   struct Instruction {
+      Op op;
+      int dst;
+      int a;
+      int b;
+      int c;
+      float value;
+   };
+
+   /**
+    * A compiled set of channel expressions. The first registers are the
+    * inputs, see the Input enum, and outputs holds the register with
+    * each channel's result.
+    */
+   struct Program {
+      QVector<Instruction> code;
+      int numRegisters = 0;
+      int outputs[4];
+      bool usesSource = false;
+   };
+
+   enum Input { InputX, InputY, InputR, InputG, InputB, InputA, NumInputs };
+
+   static QSharedPointer<const Program> compile(const QStringList& expressions, QString* error);
+
+private:
+   void run(const Program& program, const float* uniforms, float** registers, int width) const;
+
+   TextureGeneratorSettings configurables;
+   mutable QCache<QString, QSharedPointer<const Program>> programcache;
+   mutable QMutex programmutex;
+};
+
+#endif // EXPRESSIONTEXTUREGENERATOR_H
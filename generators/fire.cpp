@@ -5,9 +5,14 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/counterrandom.h"
+#include "base/parallelbands.h"
+#include "base/shaperasterizer.h"
+#include "base/warpsampler.h"
 #include "fire.h"
-#include <QPainter>
+#include <QColor>
 #include <QtMath>
+#include <cmath>
 
 /**
  * @brief FireTextureGenerator::FireTextureGenerator
@@ -40,9 +45,30 @@ FireTextureGenerator::FireTextureGenerator()
    randomize.name = "Random seed";
    randomize.order = 3;
    configurables.insert("randomize", randomize);
+
+   TextureGeneratorSetting resolution;
+   resolution.defaultvalue = QVariant((int) 512);
+   resolution.min = QVariant(16);
+   resolution.max = QVariant(4096);
+   resolution.name = "Max resolution";
+   resolution.order = 4;
+   configurables.insert("resolution", resolution);
 }
 
 
+/**
+ * @brief FireTextureGenerator::generate
+ *
+ * The fire is simulated on a grid that follows the output's size, up to
+ * the "Max resolution" setting on the longer side, and is then scaled up.
+ * The settings are tuned for the original 150 rows, so the number of
+ * iterations and the falloff per step are scaled to make the flames cover
+ * the same part of the image at every resolution. As the iterations grow
+ * with the rows, the cost grows with the cube of the resolution: a full
+ * 2048 pixel grid is 64 times the work of the default 512. Every iteration
+ * reads one buffer and writes the other, which lets the rows be split over
+ * threads.
+ */
 void FireTextureGenerator::generate(QSize size, TexturePixel* destimage,
                                     QMap<int, TextureImagePtr> sourceimages,
                                     TextureNodeSettings* settings) const
@@ -52,63 +78,85 @@ void FireTextureGenerator::generate(QSize size, TexturePixel* destimage,
    }
    double falloff = 0.245 + settings->value("falloff").toDouble() / 100;
    int iterations = settings->value("iterations").toInt();
-   uint randomize = settings->value("randomize").toUInt();
-   qsrand(randomize);
+   quint32 randomize = settings->value("randomize").toUInt();
 
-   // Speed things up by having a smaller rendering surface.
-   int screenWidth = 150;
-   int screenHeight = 150;
-   auto* renderSurface = new TexturePixel[screenWidth * screenHeight];
-   auto* fire = new int[screenHeight * screenWidth];  //this buffer will contain the fire
-   QColor palette[256]; //this will contain the color palette
-   memset(fire, 0, screenWidth * screenWidth * sizeof(int));
+   int maxSimulationSize = qMax(1, settings->value("resolution").toInt());
+   const double originalSimulationSize = 150;
+   double simulationScale = qMin(1.0, (double) maxSimulationSize / qMax(size.width(), size.height()));
+   int screenWidth = qMax(1, qRound(size.width() * simulationScale));
+   int screenHeight = qMax(4, qRound(size.height() * simulationScale));
+   double rowScale = screenHeight / originalSimulationSize;
+   int numIterations = qMax(1, qRound(iterations * rowScale));
+   double stepFalloff = pow(4 * falloff, 1 / rowScale) / 4;
+
+   auto* fire = new int[screenWidth * screenHeight];
+   auto* nextFire = new int[screenWidth * screenHeight];
+   memset(fire, 0, screenWidth * screenHeight * sizeof(int));
 
+   // Hue goes from 0 to 85: red to yellow
+   // Saturation is always the maximum: 255
+   // Lightness is 0..255 for x=0..128, and 255 for x=128..255
+   // The alpha is the same as the red value.
+   TexturePixel palette[256];
    for (int x = 0; x < 256; x++) {
-      // generate the palette
-      // Hue goes from 0 to 85: red to yellow
-      // Saturation is always the maximum: 255
-      // Lightness is 0..255 for x=0..128, and 255 for x=128..255
-      palette[x] = QColor::fromHsl(x / 3, 255, std::min(255, x * 2));
+      QColor color = QColor::fromHsl(x / 3, 255, std::min(255, x * 2));
+      palette[x] = TexturePixel(color.red(), color.green(), color.blue(), color.red());
    }
-   for (int i = 0; i < iterations; i++) {
-      // randomize the bottom row of the fire buffer
+
+   for (int i = 0; i < numIterations; i++) {
+      int* bottomRow = fire + (screenHeight - 1) * screenWidth;
       for (int x = 0; x < screenWidth; x++) {
-         fire[(screenHeight - 1) * screenWidth + x] = abs(32768 + qrand()) % 256;
-      }
-      // do the fire calculations for every pixel
-      for (int y = 0; y < screenHeight - 1; y++) {
-         for (int x = 0; x < screenWidth; x++) {
-            fire[y * screenWidth + x] = (int)
-                  ((fire[screenWidth * ((y + 1) % screenHeight) + ((x - 1 + screenWidth) % screenWidth)]
-                  + fire[screenWidth * ((y + 2) % screenHeight) + ((x) % screenWidth)]
-                  + fire[screenWidth * ((y + 1) % screenHeight) + ((x + 1) % screenWidth)]
-                  + fire[screenWidth * ((y + 3) % screenHeight) + ((x) % screenWidth)])
-                  * falloff) % 255;
-         }
+         bottomRow[x] = CounterRandom::get(randomize, x, 0, i) % 256;
       }
-      for (int y = 0; y < screenHeight; y++) {
-         for (int x = 0; x < screenWidth; x++) {
-            int thisPos = y * screenWidth + x;
-            renderSurface[thisPos].r = palette[fire[y * screenWidth + x]].red();
-            renderSurface[thisPos].g = palette[fire[y * screenWidth + x]].green();
-            renderSurface[thisPos].b = palette[fire[y * screenWidth + x]].blue();
-            renderSurface[thisPos].a = renderSurface[thisPos].r;
+      memcpy(nextFire + (screenHeight - 1) * screenWidth, bottomRow, screenWidth * sizeof(int));
+      ParallelBands::run(screenHeight - 1, [=](int startY, int endY) {
+         for (int y = startY; y < endY; y++) {
+            const int* row1 = fire + screenWidth * ((y + 1) % screenHeight);
+            const int* row2 = fire + screenWidth * ((y + 2) % screenHeight);
+            const int* row3 = fire + screenWidth * ((y + 3) % screenHeight);
+            int* destRow = nextFire + y * screenWidth;
+            for (int x = 0; x < screenWidth; x++) {
+               int left = (x == 0) ? screenWidth - 1 : x - 1;
+               int right = (x == screenWidth - 1) ? 0 : x + 1;
+               destRow[x] = static_cast<int>((row1[left] + row2[x] + row1[right] + row3[x]) * stepFalloff) % 255;
+            }
          }
-      }
+      });
+      qSwap(fire, nextFire);
    }
-   delete[] fire;
-   QImage tempimage = QImage(screenWidth, screenHeight, QImage::Format_ARGB32);
-   memcpy(tempimage.bits(), renderSurface, screenWidth * screenHeight * sizeof(TexturePixel));
-   tempimage = tempimage.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+   delete[] nextFire;
 
-   QImage destobject(size.width(), size.height(), QImage::Format_ARGB32);
-   if (sourceimages.contains(0)) {
-      memcpy(destobject.bits(), sourceimages.value(0)->getData(), size.width() * size.height() * sizeof(TexturePixel));
-   } else {
-      memset(destobject.bits(), 0, size.width() * size.height() * sizeof(TexturePixel));
+   auto* renderSurface = new TexturePixel[screenWidth * screenHeight];
+   for (int i = 0; i < screenWidth * screenHeight; i++) {
+      renderSurface[i] = palette[fire[i]];
    }
-   QPainter painter(&destobject);
-   painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-   painter.drawImage(QPoint(0, 0), tempimage);
-   memcpy(destimage, destobject.bits(), size.width() * size.height() * sizeof(TexturePixel));
+   delete[] fire;
+
+   // Scale up the fire and draw it on top of the source.
+   QSize surfaceSize(screenWidth, screenHeight);
+   TexturePixel* sourceImage = sourceimages.contains(0) ? sourceimages.value(0)->getData() : nullptr;
+   float stepX = (float) screenWidth / size.width();
+   float stepY = (float) screenHeight / size.height();
+   ParallelBands::run(size.height(), [=](int startY, int endY) {
+      for (int y = startY; y < endY; y++) {
+         float surfaceY = (y + 0.5f) * stepY - 0.5f;
+         for (int x = 0; x < size.width(); x++) {
+            int thisPos = y * size.width() + x;
+            TexturePixel flame = WarpSampler::sample(renderSurface, surfaceSize, (x + 0.5f) * stepX - 0.5f,
+                                                     surfaceY, WarpSampler::Edges::Clamp,
+                                                     WarpSampler::Filter::Bilinear);
+            if (!sourceImage || flame.a == 255) {
+               destimage[thisPos] = flame;
+               continue;
+            }
+            destimage[thisPos] = sourceImage[thisPos];
+            if (flame.a > 0) {
+               ShapeRasterizer::compositeOver(destimage[thisPos], flame, flame.a / 255.0f);
+            } else if (destimage[thisPos].a == 0) {
+               destimage[thisPos] = TexturePixel(0, 0, 0, 0);
+            }
+         }
+      }
+   });
+   delete[] renderSurface;
 }
@@ -32,10 +32,6 @@ public:
    TextureGenerator::Type getType() const override { return TextureGenerator::Type::Generator; }
 
 private:
-   double noise(double x, double y) const;
-   double findnoise2(double x,double y) const;
-   double interpolate(double a, double b, double x) const;
-
    TextureGeneratorSettings configurables;
 };
 
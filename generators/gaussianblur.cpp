@@ -28,6 +28,17 @@ GaussianBlurTextureGenerator::GaussianBlurTextureGenerator()
    weightsetting.max = QVariant(4);
    weightsetting.order = 2;
    configurables.insert("weight", weightsetting);
+
+   QStringList modes;
+   modes.append("Convolution");
+   modes.append("Recursive");
+   TextureGeneratorSetting mode;
+   mode.name = "Mode";
+   mode.description = "Recursive has a constant cost regardless of the radius "
+                      "and scales with the image size";
+   mode.defaultvalue = QVariant(modes);
+   mode.order = 3;
+   configurables.insert("mode", mode);
 }
 
 
@@ -78,6 +89,15 @@ void GaussianBlurTextureGenerator::generate(QSize size,
    }
    TexturePixel* sourceImage = sourceimages.value(0).data()->getData();
 
+   if (settings->value("mode").toString() == "Recursive") {
+      // The convolution kernel's standard deviation is numNeighbours / weight pixels
+      // at the thumbnail size of 250 pixels. Scale it so that the result looks the
+      // same regardless of the rendered image size.
+      double sigma = numNeightbours / qMax(inWeight, 0.25f) * size.width() / 250.0;
+      generateRecursive(size, destimage, sourceImage, sigma);
+      return;
+   }
+
    int pixels_on_row = 1 + (numNeightbours * 2);
 
    float* gaussian_kernel = ComputeGaussianKernel(numNeightbours, inWeight);
@@ -129,3 +149,118 @@ void GaussianBlurTextureGenerator::generate(QSize size,
    }
    delete[] gaussian_kernel;
 }
+
+
+/**
+ * @brief GaussianBlurTextureGenerator::generateRecursive
+ * @param size Image size
+ * @param destimage Target image
+ * @param sourceimage Source image, same size as the target image
+ * @param sigma Standard deviation in pixels
+ *
+ * Gaussian blur approximated with the third order recursive filter described by
+ * Young and van Vliet in "Recursive implementation of the Gaussian filter" (1995).
+ * Each pass runs once forward and once backward and the cost per pixel is
+ * constant regardless of sigma.
+ * The horizontal pass stores its result in a 8.8 fixed-point buffer. The vertical
+ * pass then walks strips of neighbouring columns row by row, so that memory is
+ * read sequentially and the channels in a strip are filtered independently.
+ */
+void GaussianBlurTextureGenerator::generateRecursive(QSize size,
+                                                     TexturePixel* destimage,
+                                                     const TexturePixel* sourceimage,
+                                                     double sigma) const
+{
+   int width = size.width();
+   int height = size.height();
+   if (sigma < 0.5) {
+      memcpy(destimage, sourceimage, width * height * sizeof(TexturePixel));
+      return;
+   }
+   double q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330
+                           : 3.97156 - 4.14554 * sqrt(1 - 0.26891 * sigma);
+   double q2 = q * q;
+   double q3 = q2 * q;
+   double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+   const float b1 = (2.44413 * q + 2.85619 * q2 + 1.26661 * q3) / b0;
+   const float b2 = -(1.4281 * q2 + 1.26661 * q3) / b0;
+   const float b3 = (0.422205 * q3) / b0;
+   const float B = 1.0f - (b1 + b2 + b3);
+
+   const auto* src = reinterpret_cast<const unsigned char*>(sourceimage);
+   auto* dst = reinterpret_cast<unsigned char*>(destimage);
+   int rowLength = width * 4;
+
+   // Horizontal pass. Edges are extended by repeating the outermost pixel,
+   // which is the steady state of the filter for a constant signal.
+   auto* intermediate = new quint16[rowLength * height];
+   auto* rowBuffer = new float[rowLength];
+   for (int y = 0; y < height; y++) {
+      const unsigned char* srcRow = src + y * rowLength;
+      quint16* intermediateRow = intermediate + y * rowLength;
+      for (int c = 0; c < 4; c++) {
+         float p1 = srcRow[c];
+         float p2 = p1;
+         float p3 = p1;
+         for (int pos = c; pos < rowLength; pos += 4) {
+            float val = B * srcRow[pos] + b1 * p1 + b2 * p2 + b3 * p3;
+            rowBuffer[pos] = val;
+            p3 = p2;
+            p2 = p1;
+            p1 = val;
+         }
+         p2 = p3 = p1;
+         for (int pos = rowLength - 4 + c; pos >= 0; pos -= 4) {
+            float val = B * rowBuffer[pos] + b1 * p1 + b2 * p2 + b3 * p3;
+            p3 = p2;
+            p2 = p1;
+            p1 = val;
+            intermediateRow[pos] = static_cast<quint16>(qBound(0, static_cast<int>(val * 256 + 0.5f), 65535));
+         }
+      }
+   }
+   delete[] rowBuffer;
+
+   // Vertical pass, in strips of 16 columns.
+   const int stripPixels = 16;
+   const int stripLanes = stripPixels * 4;
+   const float fixedToFloat = 1.0f / 256;
+   auto* stripBuffer = new float[stripLanes * height];
+   float p1[stripLanes];
+   float p2[stripLanes];
+   float p3[stripLanes];
+   for (int x = 0; x < width; x += stripPixels) {
+      int lanes = qMin(stripPixels, width - x) * 4;
+      const quint16* column = intermediate + x * 4;
+      for (int l = 0; l < lanes; l++) {
+         p1[l] = p2[l] = p3[l] = column[l] * fixedToFloat;
+      }
+      for (int y = 0; y < height; y++) {
+         const quint16* in = column + y * rowLength;
+         float* out = stripBuffer + y * lanes;
+         for (int l = 0; l < lanes; l++) {
+            float val = B * (in[l] * fixedToFloat) + b1 * p1[l] + b2 * p2[l] + b3 * p3[l];
+            out[l] = val;
+            p3[l] = p2[l];
+            p2[l] = p1[l];
+            p1[l] = val;
+         }
+      }
+      for (int l = 0; l < lanes; l++) {
+         p2[l] = p3[l] = p1[l];
+      }
+      for (int y = height - 1; y >= 0; y--) {
+         const float* in = stripBuffer + y * lanes;
+         unsigned char* out = dst + y * rowLength + x * 4;
+         for (int l = 0; l < lanes; l++) {
+            float val = B * in[l] + b1 * p1[l] + b2 * p2[l] + b3 * p3[l];
+            p3[l] = p2[l];
+            p2[l] = p1[l];
+            p1[l] = val;
+            out[l] = static_cast<unsigned char>(qBound(0, static_cast<int>(val + 0.5f), 255));
+         }
+      }
+   }
+   delete[] stripBuffer;
+   delete[] intermediate;
+}
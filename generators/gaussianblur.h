@@ -31,6 +31,8 @@ public:
 private:
    TextureGeneratorSettings configurables;
    float* ComputeGaussianKernel(const int inRadius, const float inWeight) const;
+   void generateRecursive(QSize size, TexturePixel* destimage,
+                          const TexturePixel* sourceimage, double sigma) const;
 };
 
 #endif // GAUSSIANBLURTEXTUREGENERATOR_H
@@ -5,19 +5,13 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/parallelbands.h"
 #include "blending.h"
-#include "cutout.h"
-#include "fill.h"
 #include "glow.h"
-#include "merge.h"
-#include "modifylevels.h"
-#include "modifylevels.h"
-#include "setchannels.h"
-#include "stackblur.h"
-#include "transform.h"
 #include <QColor>
 #include <QMap>
 #include <cmath>
+#include <limits>
 
 GlowTextureGenerator::GlowTextureGenerator()
 {
@@ -94,6 +88,213 @@ GlowTextureGenerator::GlowTextureGenerator()
    configurables.insert("includesource", includesource);
 }
 
+/**
+ * @brief GlowTextureGenerator::distanceTransform
+ * @param f Squared distance of every sample, negative if the sample isn't a feature
+ * @param n Number of samples
+ * @param borderFeatures Whether the samples just outside both ends are features
+ * @param d Set to the squared distance to the nearest feature, -1 if there is none
+ * @param v Buffer for n + 2 site positions
+ * @param z Buffer for n + 3 parabola boundaries
+ *
+ * One dimensional squared Euclidean distance transform (Felzenszwalb and
+ * Huttenlocher), computing the lower envelope of the parabolas rooted at the
+ * feature samples in linear time. The image doesn't wrap, everything outside
+ * of it is treated as being outside the mask.
+ */
+void GlowTextureGenerator::distanceTransform(const float* f, int n, bool borderFeatures,
+                                             float* d, int* v, float* z) const
+{
+   auto sample = [=](int q) {
+      if (q < 0 || q >= n) {
+         return borderFeatures ? 0.0f : -1.0f;
+      }
+      return f[q];
+   };
+   int k = -1;
+   for (int q = -1; q <= n; q++) {
+      float fq = sample(q);
+      if (fq < 0) {
+         continue;
+      }
+      float s = 0;
+      while (k >= 0) {
+         float fv = sample(v[k]);
+         s = ((fq + q * q) - (fv + v[k] * v[k])) / (2.0f * (q - v[k]));
+         if (s > z[k]) {
+            break;
+         }
+         k--;
+      }
+      k++;
+      v[k] = q;
+      z[k] = (k == 0) ? -std::numeric_limits<float>::max() : s;
+      z[k + 1] = std::numeric_limits<float>::max();
+   }
+   if (k < 0) {
+      for (int q = 0; q < n; q++) {
+         d[q] = -1;
+      }
+      return;
+   }
+   k = 0;
+   for (int q = 0; q < n; q++) {
+      while (z[k + 1] < q) {
+         k++;
+      }
+      float fv = sample(v[k]);
+      d[q] = (q - v[k]) * (q - v[k]) + fv;
+   }
+}
+
+
+/**
+ * @brief GlowTextureGenerator::distanceField
+ * @param size Image size
+ * @param mask Coverage mask
+ * @param inside Whether the distance should be to the nearest pixel in or out of the mask
+ * @param dist Set to the distance in pixels, or a very large value if there are no such pixels
+ *
+ * Two dimensional distance transform, first along the columns and then
+ * along the rows. Both passes are split over the available threads.
+ * The pixels outside the image count as outside the mask.
+ */
+void GlowTextureGenerator::distanceField(QSize size, const bool* mask, bool inside, float* dist) const
+{
+   int width = size.width();
+   int height = size.height();
+   ParallelBands::run(width, [=](int startX, int endX) {
+      auto* f = new float[height];
+      auto* d = new float[height];
+      auto* v = new int[height + 2];
+      auto* z = new float[height + 3];
+      for (int x = startX; x < endX; x++) {
+         for (int y = 0; y < height; y++) {
+            f[y] = (mask[y * width + x] == inside) ? 0 : -1;
+         }
+         distanceTransform(f, height, !inside, d, v, z);
+         for (int y = 0; y < height; y++) {
+            dist[y * width + x] = d[y];
+         }
+      }
+      delete[] f;
+      delete[] d;
+      delete[] v;
+      delete[] z;
+   });
+   ParallelBands::run(height, [=](int startY, int endY) {
+      auto* d = new float[width];
+      auto* v = new int[width + 2];
+      auto* z = new float[width + 3];
+      for (int y = startY; y < endY; y++) {
+         float* line = dist + y * width;
+         distanceTransform(line, width, !inside, d, v, z);
+         for (int x = 0; x < width; x++) {
+            line[x] = (d[x] < 0) ? std::numeric_limits<float>::max() : std::sqrt(d[x]);
+         }
+      }
+      delete[] d;
+      delete[] v;
+      delete[] z;
+   });
+}
+
+
+/**
+ * @brief GlowTextureGenerator::signedDistanceField
+ * @param size Image size
+ * @param mask Coverage mask
+ * @param dist Set to the distance to the mask's edge, negative inside the mask
+ */
+void GlowTextureGenerator::signedDistanceField(QSize size, const bool* mask, float* dist) const
+{
+   int numPixels = size.width() * size.height();
+   auto* insideDist = new float[numPixels];
+   distanceField(size, mask, true, dist);
+   distanceField(size, mask, false, insideDist);
+   for (int i = 0; i < numPixels; i++) {
+      dist[i] = mask[i] ? 0.5f - insideDist[i] : dist[i] - 0.5f;
+   }
+   delete[] insideDist;
+}
+
+
+/**
+ * @brief GlowTextureGenerator::scaledMask
+ * @param size Image size
+ * @param source Source image
+ * @param scaleX Horizontal scale factor around the center
+ * @param scaleY Vertical scale factor around the center
+ * @param mask Set to true for the pixels covered by the scaled source
+ *
+ * Nearest neighbour sampling. Like the transformed copies the glow used
+ * to be drawn from, the mask is empty where it samples outside the source.
+ */
+void GlowTextureGenerator::scaledMask(QSize size, const TexturePixel* source,
+                                      double scaleX, double scaleY, bool* mask) const
+{
+   int width = size.width();
+   int height = size.height();
+   if (scaleX <= 0 || scaleY <= 0) {
+      memset(mask, 0, width * height * sizeof(bool));
+      return;
+   }
+   auto* sourceColumns = new int[width];
+   for (int x = 0; x < width; x++) {
+      double srcX = std::floor((x + 0.5 - width / 2) / scaleX + width / 2);
+      sourceColumns[x] = (srcX >= 0 && srcX < width) ? static_cast<int>(srcX) : -1;
+   }
+   for (int y = 0; y < height; y++) {
+      double srcY = std::floor((y + 0.5 - height / 2) / scaleY + height / 2);
+      if (srcY < 0 || srcY >= height) {
+         memset(mask + y * width, 0, width * sizeof(bool));
+         continue;
+      }
+      const TexturePixel* sourceRow = source + static_cast<int>(srcY) * width;
+      for (int x = 0; x < width; x++) {
+         mask[y * width + x] = sourceColumns[x] >= 0 && sourceRow[sourceColumns[x]].a > 0;
+      }
+   }
+   delete[] sourceColumns;
+}
+
+
+/**
+ * @brief GlowTextureGenerator::edgeCoverage
+ * @param distance Distance outside of the edge, negative inside
+ * @param blurRadius Blur radius in pixels
+ * @return Coverage in the range [0, 1]
+ *
+ * The coverage a hard edge gets after being blurred by a triangular kernel,
+ * which is what the stack blur approximates.
+ */
+float GlowTextureGenerator::edgeCoverage(float distance, float blurRadius) const
+{
+   if (blurRadius <= 0) {
+      return distance <= 0 ? 1 : 0;
+   }
+   float t = distance / (blurRadius + 1);
+   if (t <= -1) {
+      return 1;
+   }
+   if (t >= 1) {
+      return 0;
+   }
+   if (t < 0) {
+      return 1 - (1 + t) * (1 + t) / 2;
+   }
+   return (1 - t) * (1 - t) / 2;
+}
+
+
+/**
+ * @brief GlowTextureGenerator::generate
+ *
+ * The glow is the source's shape grown by the glow size, computed from a
+ * distance transform of the source's alpha channel. The blur is folded
+ * into the falloff from the shape's edge, so no intermediate images
+ * besides the glow itself are created.
+ */
 void GlowTextureGenerator::generate(QSize size,
                                     TexturePixel* destimage,
                                     QMap<int, TextureImagePtr> sourceimages,
@@ -107,175 +308,84 @@ void GlowTextureGenerator::generate(QSize size,
       return;
    }
 
-   StackBlurTextureGenerator stackblurgen;
-
-   double offset = settings->value("size").toDouble();
+   int width = size.width();
+   int height = size.height();
+   int numPixels = width * height;
+   TexturePixel* sourceImage = sourceimages.value(0)->getData();
+   QColor color = settings->value("color").value<QColor>();
+   double glowSize = settings->value("size").toDouble();
    QString mode = settings->value("mode").toString();
+   bool ontop = settings->value("ontop").toBool();
+   float blurScale = qMax(width / 100, 1);
+   float firstBlur = static_cast<int>(settings->value("firstblurlevel").toInt() * blurScale);
+   float secondBlur = ontop ? static_cast<int>(settings->value("secondblurlevel").toInt() * blurScale) : 0;
 
-   TransformTextureGenerator transformgen;
-   TextureNodeSettings settingsForTransform;
-   QMapIterator<QString, TextureGeneratorSetting> transformSettingsIterator(transformgen.getSettings());
-   while (transformSettingsIterator.hasNext()) {
-      transformSettingsIterator.next();
-      settingsForTransform.insert(transformSettingsIterator.key(), transformSettingsIterator.value().defaultvalue);
-   }
-   auto* mergedImage = new TexturePixel[size.width() * size.height()];
-   auto mergedImagePtr = TextureImagePtr(new TextureImage(size, mergedImage));
-
+   auto* mask = new bool[numPixels];
+   auto* dist = new float[numPixels];
+   float glowRadius = 0;
    if (mode == "Multiply") {
-      auto* transformedLeftImage = new TexturePixel[size.width() * size.height()];
-      auto* transformedRightImage = new TexturePixel[size.width() * size.height()];
-      auto* transformedTopImage = new TexturePixel[size.width() * size.height()];
-      auto* transformedDownImage = new TexturePixel[size.width() * size.height()];
-      auto* transformedTopLeftImage = new TexturePixel[size.width() * size.height()];
-      auto* transformedTopRightImage = new TexturePixel[size.width() * size.height()];
-      auto* transformedDownLeftImage = new TexturePixel[size.width() * size.height()];
-      auto* transformedDownRightImage = new TexturePixel[size.width() * size.height()];
-      auto transformedLeftImagePtr = TextureImagePtr(new TextureImage(size, transformedLeftImage));
-      auto transformedRightImagePtr = TextureImagePtr(new TextureImage(size, transformedRightImage));
-      auto transformedTopImagePtr = TextureImagePtr(new TextureImage(size, transformedTopImage));
-      auto transformedDownImagePtr = TextureImagePtr(new TextureImage(size, transformedDownImage));
-      auto transformedTopLeftImagePtr = TextureImagePtr(new TextureImage(size, transformedTopLeftImage));
-      auto transformedTopRightImagePtr = TextureImagePtr(new TextureImage(size, transformedTopRightImage));
-      auto transformedDownLeftImagePtr = TextureImagePtr(new TextureImage(size, transformedDownLeftImage));
-      auto transformedDownRightImagePtr = TextureImagePtr(new TextureImage(size, transformedDownRightImage));
-      settingsForTransform.insert("offsetleft", -offset);
-      settingsForTransform.insert("offsettop", 0);
-      transformgen.generate(size, transformedLeftImage, sourceimages, &settingsForTransform);
-      settingsForTransform.insert("offsetleft", offset);
-      settingsForTransform.insert("offsettop", 0);
-      transformgen.generate(size, transformedRightImage, sourceimages, &settingsForTransform);
-      settingsForTransform.insert("offsetleft", 0);
-      settingsForTransform.insert("offsettop", -offset);
-      transformgen.generate(size, transformedTopImage, sourceimages, &settingsForTransform);
-      settingsForTransform.insert("offsetleft", 0);
-      settingsForTransform.insert("offsettop", offset);
-      transformgen.generate(size, transformedDownImage, sourceimages, &settingsForTransform);
-      settingsForTransform.insert("offsetleft", -offset * 0.705);
-      settingsForTransform.insert("offsettop", -offset * 0.705);
-      transformgen.generate(size, transformedTopLeftImage, sourceimages, &settingsForTransform);
-      settingsForTransform.insert("offsetleft", offset * 0.705);
-      settingsForTransform.insert("offsettop", -offset * 0.705);
-      transformgen.generate(size, transformedTopRightImage, sourceimages, &settingsForTransform);
-      settingsForTransform.insert("offsetleft", -offset * 0.705);
-      settingsForTransform.insert("offsettop", offset * 0.705);
-      transformgen.generate(size, transformedDownLeftImage, sourceimages, &settingsForTransform);
-      settingsForTransform.insert("offsetleft", offset * 0.705);
-      settingsForTransform.insert("offsettop", offset * 0.705);
-      transformgen.generate(size, transformedDownRightImage, sourceimages, &settingsForTransform);
-
-      MergeTextureGenerator mergegen;
-      QMap<int, TextureImagePtr> mergeImages;
-      mergeImages.insert(0, transformedLeftImagePtr);
-      mergeImages.insert(1, transformedRightImagePtr);
-      mergeImages.insert(2, transformedTopImagePtr);
-      mergeImages.insert(3, transformedDownImagePtr);
-      mergeImages.insert(4, transformedTopLeftImagePtr);
-      mergeImages.insert(5, transformedTopRightImagePtr);
-      mergeImages.insert(6, transformedDownLeftImagePtr);
-      mergeImages.insert(7, transformedDownRightImagePtr);
-      mergegen.generate(size, mergedImage, mergeImages, settings);
+      for (int i = 0; i < numPixels; i++) {
+         mask[i] = sourceImage[i].a > 0;
+      }
+      glowRadius = static_cast<float>(glowSize * width / 100);
    } else {
-      settingsForTransform.insert("xscale", offset * 3 + 100);
-      settingsForTransform.insert("yscale", offset * 3 + 100);
-      transformgen.generate(size, mergedImage, sourceimages, &settingsForTransform);
+      double scale = (glowSize * 3 + 100) / 100;
+      scaledMask(size, sourceImage, scale, scale, mask);
    }
-
-   FillTextureGenerator fillgen;
-   auto* filledImage = new TexturePixel[size.width() * size.height()];
-   auto filledImagePtr = TextureImagePtr(new TextureImage(size, filledImage));
-   fillgen.generate(size, filledImage, sourceimages, settings);
-
-   SetChannelsTextureGenerator setchannelsgen;
-   QMap<int, TextureImagePtr> setchannelImages;
-   setchannelImages.insert(0, filledImagePtr);
-   setchannelImages.insert(1, mergedImagePtr);
-   TextureNodeSettings settingsForSetchannels;
-   settingsForSetchannels.insert("channelRed", QVariant("First's red"));
-   settingsForSetchannels.insert("channelGreen", QVariant("First's green"));
-   settingsForSetchannels.insert("channelBlue", QVariant("First's blue"));
-   settingsForSetchannels.insert("channelAlpha", QVariant("Second's alpha"));
-   auto* setchannelsImage = new TexturePixel[size.width() * size.height()];
-   auto setchannelsImagePtr = TextureImagePtr(new TextureImage(size, setchannelsImage));
-   setchannelsgen.generate(size, setchannelsImage, setchannelImages, &settingsForSetchannels);
-
-   ModifyLevelsTextureGenerator modifylevelsgen;
-   QMap<int, TextureImagePtr> modifylevelsImages;
-   modifylevelsImages.insert(0, setchannelsImagePtr);
-   TextureNodeSettings settingsForModifyLevels;
-   settingsForModifyLevels.insert("channel", "Only alpha");
-   settingsForModifyLevels.insert("mode", "Multiply");
-   settingsForModifyLevels.insert("level", 500);
-   auto* modifylevelsImage = new TexturePixel[size.width() * size.height()];
-   auto modifylevelsImagePtr = TextureImagePtr(new TextureImage(size, modifylevelsImage));
-   modifylevelsgen.generate(size, modifylevelsImage, modifylevelsImages, &settingsForModifyLevels);
-
-   QMap<int, TextureImagePtr> firstblurImages;
-   firstblurImages.insert(0, modifylevelsImagePtr);
-   TextureNodeSettings settingsForFirstBlur;
-   settingsForFirstBlur.insert("level", QVariant(settings->value("firstblurlevel").toInt()));
-   auto* firstblurredImage = new TexturePixel[size.width() * size.height()];
-   auto firstblurredImagePtr = TextureImagePtr(new TextureImage(size, firstblurredImage));
-   stackblurgen.generate(size, firstblurredImage, firstblurImages, &settingsForFirstBlur);
-
-   if (settings->value("ontop").toBool()) {
-      auto* smallerCutoutImage = new TexturePixel[size.width() * size.height()];
-      auto smallerCutoutImagePtr = TextureImagePtr(new TextureImage(size, smallerCutoutImage));
-      settingsForTransform.insert("offsetleft", 0);
-      settingsForTransform.insert("offsettop", 0);
-      double cutoutx = settings->value("cutoutx").toDouble();
-      double cutouty = settings->value("cutouty").toDouble();
-      settingsForTransform.insert("xscale", cutoutx);
-      settingsForTransform.insert("yscale", cutouty);
-      transformgen.generate(size, smallerCutoutImage, sourceimages, &settingsForTransform);
-
-      CutoutTextureGenerator cutoutgen;
-      QMap<int, TextureImagePtr> cutoutImages;
-      cutoutImages.insert(0, firstblurredImagePtr);
-      cutoutImages.insert(1, smallerCutoutImagePtr);
-      TextureNodeSettings settingsForCutout;
-      settingsForCutout.insert("factor", 255);
-      auto* cutoutImage = new TexturePixel[size.width() * size.height()];
-      auto cutoutImagePtr = TextureImagePtr(new TextureImage(size, cutoutImage));
-      cutoutgen.generate(size, cutoutImage, cutoutImages, &settingsForCutout);
-
-      QMap<int, TextureImagePtr> secondblurImages;
-      secondblurImages.insert(0, cutoutImagePtr);
-      TextureNodeSettings settingsForsecondBlur;
-      settingsForsecondBlur.insert("level", QVariant(settings->value("secondblurlevel").toInt()));
-      auto* secondblurredImage = new TexturePixel[size.width() * size.height()];
-      auto secondblurredImagePtr = TextureImagePtr(new TextureImage(size, secondblurredImage));
-      stackblurgen.generate(size, secondblurredImage, secondblurImages, &settingsForsecondBlur);
-      firstblurredImagePtr = secondblurredImagePtr;
+   if (ontop) {
+      signedDistanceField(size, mask, dist);
    } else {
-      CutoutTextureGenerator cutoutgen;
-      QMap<int, TextureImagePtr> cutoutImages;
-      cutoutImages.insert(0, firstblurredImagePtr);
-      cutoutImages.insert(1, sourceimages.value(0));
-      TextureNodeSettings settingsForCutout;
-      settingsForCutout.insert("factor", 255);
-      auto* cutoutImage = new TexturePixel[size.width() * size.height()];
-      auto cutoutImagePtr = TextureImagePtr(new TextureImage(size, cutoutImage));
-      cutoutgen.generate(size, cutoutImage, cutoutImages, &settingsForCutout);
-      firstblurredImagePtr = cutoutImagePtr;
+      // Only the glow outside of the source is kept, so the distances inside aren't needed.
+      distanceField(size, mask, true, dist);
+      for (int i = 0; i < numPixels; i++) {
+         dist[i] -= 0.5f;
+      }
    }
 
+   float* cutoutDist = nullptr;
+   if (ontop) {
+      cutoutDist = new float[numPixels];
+      scaledMask(size, sourceImage,
+                 settings->value("cutoutx").toDouble() / 100,
+                 settings->value("cutouty").toDouble() / 100, mask);
+      signedDistanceField(size, mask, cutoutDist);
+   }
+
+   auto* glowImage = new TexturePixel[numPixels];
+   auto glowImagePtr = TextureImagePtr(new TextureImage(size, glowImage));
+   float outerBlur = firstBlur + secondBlur;
+   float colorAlpha = color.alpha();
+   ParallelBands::run(height, [=](int startY, int endY) {
+      for (int i = startY * width; i < endY * width; i++) {
+         float coverage = edgeCoverage(dist[i] - glowRadius, outerBlur);
+         if (cutoutDist) {
+            coverage *= 1 - edgeCoverage(cutoutDist[i], secondBlur);
+         } else if (sourceImage[i].a > 0) {
+            coverage = 0;
+         }
+         glowImage[i] = TexturePixel(static_cast<unsigned char>(color.red()),
+                                     static_cast<unsigned char>(color.green()),
+                                     static_cast<unsigned char>(color.blue()),
+                                     static_cast<unsigned char>(coverage * colorAlpha + 0.5f));
+      }
+   });
+   delete[] mask;
+   delete[] dist;
+   delete[] cutoutDist;
+
    if (settings->value("includesource").toBool()) {
       BlendingTextureGenerator blendinggen;
       QMap<int, TextureImagePtr> sourceForBlend;
       sourceForBlend.insert(0, sourceimages.value(0));
-      sourceForBlend.insert(1, firstblurredImagePtr);
+      sourceForBlend.insert(1, glowImagePtr);
       TextureNodeSettings settingsForBlend;
       QMapIterator<QString, TextureGeneratorSetting> blendSettingsIterator(blendinggen.getSettings());
       while (blendSettingsIterator.hasNext()) {
          blendSettingsIterator.next();
          settingsForBlend.insert(blendSettingsIterator.key(), blendSettingsIterator.value().defaultvalue);
       }
-      auto* blendedImage = new TexturePixel[size.width() * size.height()];
-      blendinggen.generate(size, blendedImage, sourceForBlend, &settingsForBlend);
-      memcpy(destimage, blendedImage, size.width() * size.height() * sizeof(TexturePixel));
-      delete[] blendedImage;
+      blendinggen.generate(size, destimage, sourceForBlend, &settingsForBlend);
    } else {
-      memcpy(destimage, firstblurredImagePtr->getData(), size.width() * size.height() * sizeof(TexturePixel));
+      memcpy(destimage, glowImage, numPixels * sizeof(TexturePixel));
    }
 }
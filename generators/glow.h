@@ -29,6 +29,14 @@ public:
    TextureGenerator::Type getType() const override { return TextureGenerator::Type::Filter; }
 
 private:
+   void distanceTransform(const float* f, int n, bool borderFeatures,
+                          float* d, int* v, float* z) const;
+   void distanceField(QSize size, const bool* mask, bool inside, float* dist) const;
+   void signedDistanceField(QSize size, const bool* mask, float* dist) const;
+   void scaledMask(QSize size, const TexturePixel* source,
+                   double scaleX, double scaleY, bool* mask) const;
+   float edgeCoverage(float distance, float blurRadius) const;
+
    TextureGeneratorSettings configurables;
 };
 
@@ -5,11 +5,39 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/parallelbands.h"
+#include "base/shaperasterizer.h"
 #include "gradient.h"
 #include <QColor>
-#include <QGradient>
-#include <QGraphicsOpacityEffect>
-#include <QPainter>
+#include <QtMath>
+#include <cmath>
+
+/**
+ * Number of entries in the precomputed color ramp.
+ */
+static const int rampSize = 1024;
+
+/**
+ * Approximation of atan2, accurate to around 1e-5 radians which is
+ * well below the resolution of the color ramp.
+ */
+static inline float fastAtan2(float y, float x)
+{
+   float absX = std::fabs(x);
+   float absY = std::fabs(y);
+   float maxValue = qMax(absX, absY);
+   float ratio = maxValue > 0 ? qMin(absX, absY) / maxValue : 0;
+   float square = ratio * ratio;
+   float angle = ratio * (0.99997726f + square * (-0.33262347f + square * (0.19354346f +
+                  square * (-0.11643287f + square * (0.05265332f + square * -0.01172120f)))));
+   if (absY > absX) {
+      angle = (float) M_PI_2 - angle;
+   }
+   if (x < 0) {
+      angle = (float) M_PI - angle;
+   }
+   return y < 0 ? -angle : angle;
+}
 
 
 GradientTextureGenerator::GradientTextureGenerator()
@@ -102,6 +130,49 @@ GradientTextureGenerator::GradientTextureGenerator()
 }
 
 
+/**
+ * @brief GradientTextureGenerator::buildColorRamp
+ * @param ramp Array with rampSize entries to fill
+ * @param startcolor Color at position 0
+ * @param middlecolor Color at middleposition
+ * @param endcolor Color at position 1
+ * @param middleposition Position of the middle color, between 0 and 1
+ *
+ * The colors are interpolated without premultiplied alpha,
+ * same as QGradient's default interpolation mode.
+ */
+void GradientTextureGenerator::buildColorRamp(TexturePixel* ramp, const QColor& startcolor,
+                                              const QColor& middlecolor, const QColor& endcolor,
+                                              double middleposition) const
+{
+   for (int i = 0; i < rampSize; i++) {
+      double position = (double) i / (rampSize - 1);
+      const QColor* from = &middlecolor;
+      const QColor* to = &endcolor;
+      double weight = 1;
+      if (position < middleposition) {
+         from = &startcolor;
+         to = &middlecolor;
+         weight = position / middleposition;
+      } else if (middleposition < 1) {
+         weight = (position - middleposition) / (1 - middleposition);
+      }
+      ramp[i] = TexturePixel(
+               static_cast<unsigned char>(from->red() + (to->red() - from->red()) * weight + 0.5),
+               static_cast<unsigned char>(from->green() + (to->green() - from->green()) * weight + 0.5),
+               static_cast<unsigned char>(from->blue() + (to->blue() - from->blue()) * weight + 0.5),
+               static_cast<unsigned char>(from->alpha() + (to->alpha() - from->alpha()) * weight + 0.5));
+   }
+}
+
+
+/**
+ * @brief GradientTextureGenerator::generate
+ *
+ * Computes each pixel's position along the gradient directly from its
+ * coordinates, applies the spread and looks up the color in a ramp.
+ * The gradient is then composited on top of the source image.
+ */
 void GradientTextureGenerator::generate(QSize size,
                                         TexturePixel* destimage,
                                         QMap<int, TextureImagePtr> sourceimages,
@@ -115,18 +186,17 @@ void GradientTextureGenerator::generate(QSize size,
    QColor startcolor = settings->value("startcolor").value<QColor>();
    QColor middlecolor = settings->value("middlecolor").value<QColor>();
    QColor endcolor = settings->value("endcolor").value<QColor>();
-   double middleposition = settings->value("middleposition").toDouble() / 100;
+   double middleposition = qBound(0.0, settings->value("middleposition").toDouble() / 100, 1.0);
    double startposx = settings->value("startposx").toDouble() * size.width() / 100;
    double startposy = settings->value("startposy").toDouble() * size.height() / 100;
    double endposx = settings->value("endposx").toDouble() * size.width() / 100;
    double endposy = settings->value("endposy").toDouble() * size.height() / 100;
    double radius = settings->value("radius").toDouble() * size.width() / 100;
 
-   QImage tempimage = QImage(size.width(), size.height(), QImage::Format_RGB32);
    if (sourceimages.contains(0)) {
-      memcpy(tempimage.bits(), sourceimages.value(0)->getData(), size.width() * size.height() * sizeof(TexturePixel));
+      memcpy(destimage, sourceimages.value(0)->getData(), size.width() * size.height() * sizeof(TexturePixel));
    } else {
-      memset(tempimage.bits(), 0, size.width() * size.height() * sizeof(TexturePixel));
+      memset(destimage, 0, size.width() * size.height() * sizeof(TexturePixel));
    }
 
    startposx += (double) 50 * size.width() / 100;
@@ -134,34 +204,102 @@ void GradientTextureGenerator::generate(QSize size,
    endposx += (double) 50 * size.width() / 100;
    endposy += (double) 50 * size.height() / 100;
 
-   QGradient gradient;
-   if (gradientmode == "Linear Gradient") {
-      gradient = QLinearGradient(startposx, startposy, endposx, endposy);
-   } else if (gradientmode == "Radial Gradient") {
-      gradient = QRadialGradient(startposx, startposy, radius, endposx, endposy);
+   TexturePixel ramp[rampSize];
+   buildColorRamp(ramp, startcolor, middlecolor, endcolor, middleposition);
+
+   enum class Mode { Linear, Radial, Conical } mode = Mode::Linear;
+   if (gradientmode == "Radial Gradient") {
+      mode = Mode::Radial;
    } else if (gradientmode == "Conical Gradient") {
-      QLineF l(startposx, startposy, endposx, endposy);
-      double angle = l.angle(QLineF(0, 0, 1, 0));
-      if (l.dy() > 0) {
-         angle = 360 - angle;
-      }
-      gradient = QConicalGradient(startposx, startposy, angle);
+      mode = Mode::Conical;
    }
-
-   QGradient::Spread spread = QGradient::PadSpread;
+   enum class Spread { Pad, Reflect, Repeat } spread = Spread::Pad;
    if (spreadmode == "Reflect Spread") {
-      spread = QGradient::ReflectSpread;
+      spread = Spread::Reflect;
    } else if (spreadmode == "Repeat Spread") {
-      spread = QGradient::RepeatSpread;
+      spread = Spread::Repeat;
+   }
+
+   // Linear: the position is the projection on the line from start to end.
+   float lineX = endposx - startposx;
+   float lineY = endposy - startposy;
+   float lineLengthSquared = lineX * lineX + lineY * lineY;
+   if (lineLengthSquared > 0) {
+      lineX /= lineLengthSquared;
+      lineY /= lineLengthSquared;
    }
-   gradient.setSpread(spread);
-   gradient.setColorAt(0, startcolor);
-   gradient.setColorAt(middleposition, middlecolor);
-   gradient.setColorAt(1, endcolor);
 
-   QPainter painter(&tempimage);
-   painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-   painter.fillRect(0, 0, size.width(), size.height(), gradient);
+   // Radial: the position is t for which the pixel lies on the circle
+   // centered at focal + t * (center - focal) with the radius t * radius.
+   // As with QRadialGradient, a focal point outside the circle is moved
+   // to the circle's edge.
+   float centerX = startposx;
+   float centerY = startposy;
+   float focalX = endposx;
+   float focalY = endposy;
+   float focalDistance = std::sqrt((focalX - centerX) * (focalX - centerX) +
+                                   (focalY - centerY) * (focalY - centerY));
+   if (focalDistance > radius) {
+      float scale = focalDistance > 0 ? radius / focalDistance : 0;
+      focalX = centerX + (focalX - centerX) * scale;
+      focalY = centerY + (focalY - centerY) * scale;
+   }
+   float toCenterX = centerX - focalX;
+   float toCenterY = centerY - focalY;
+   float radialA = toCenterX * toCenterX + toCenterY * toCenterY - radius * radius;
 
-   memcpy(destimage, tempimage.bits(), size.width() * size.height() * sizeof(TexturePixel));
+   // Conical: the position goes counter-clockwise a full turn, starting
+   // in the direction from the start to the end position.
+   float startAngle = std::atan2(-(endposy - startposy), endposx - startposx);
+
+   int width = size.width();
+   ParallelBands::run(size.height(), [&](int startY, int endY) {
+      auto* positions = new float[width];
+      for (int y = startY; y < endY; y++) {
+         float pixelY = y + 0.5f;
+         if (mode == Mode::Linear) {
+            float rowPosition = (pixelY - (float) startposy) * lineY + (0.5f - (float) startposx) * lineX;
+            for (int x = 0; x < width; x++) {
+               positions[x] = rowPosition + x * lineX;
+            }
+         } else if (mode == Mode::Radial) {
+            float dy = pixelY - focalY;
+            for (int x = 0; x < width; x++) {
+               float dx = x + 0.5f - focalX;
+               // Solves radialA * t^2 - 2 * b * t + c = 0 for the largest t.
+               float b = dx * toCenterX + dy * toCenterY;
+               float c = dx * dx + dy * dy;
+               float denominator = b + std::sqrt(qMax(b * b - radialA * c, 0.0f));
+               positions[x] = denominator > 0 ? c / denominator : 1e9f;
+            }
+         } else {
+            float dy = pixelY - startposy;
+            for (int x = 0; x < width; x++) {
+               float dx = x + 0.5f - startposx;
+               float position = (fastAtan2(-dy, dx) - startAngle) / (2 * (float) M_PI);
+               positions[x] = position - std::floor(position);
+            }
+         }
+
+         TexturePixel* destRow = destimage + y * width;
+         for (int x = 0; x < width; x++) {
+            float position = positions[x];
+            if (spread == Spread::Repeat) {
+               position -= std::floor(position);
+            } else if (spread == Spread::Reflect) {
+               position -= 2 * std::floor(position / 2);
+               position = position > 1 ? 2 - position : position;
+            }
+            position = qBound(0.0f, position, 1.0f);
+            const TexturePixel& color = ramp[static_cast<int>(position * (rampSize - 1) + 0.5f)];
+            TexturePixel& pixel = destRow[x];
+            if (color.a == 255 || pixel.a == 0) {
+               pixel = color;
+            } else if (color.a > 0) {
+               ShapeRasterizer::compositeOver(pixel, color, color.a / 255.0f);
+            }
+         }
+      }
+      delete[] positions;
+   });
 }
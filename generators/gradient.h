@@ -9,6 +9,7 @@
 #define GRADIENTTEXTUREGENERATOR_H
 
 #include "texturegenerator.h"
+#include <QColor>
 
 /**
  * @brief The GradientTextureGenerator class
@@ -29,6 +30,10 @@ public:
    TextureGenerator::Type getType() const override { return TextureGenerator::Type::Generator; }
 
 private:
+   void buildColorRamp(TexturePixel* ramp, const QColor& startcolor,
+                       const QColor& middlecolor, const QColor& endcolor,
+                       double middleposition) const;
+
    TextureGeneratorSettings configurables;
 };
 
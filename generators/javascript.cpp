@@ -8,9 +8,13 @@
 #include "base/settingsmanager.h"
 #include "base/textureproject.h"
 #include "javascript.h"
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDebug>
 #include <QDirIterator>
 #include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -37,6 +41,54 @@
 #endif
 #endif
 
+#ifndef DISABLE_JAVASCRIPT
+/**
+ * Number of renders between garbage collections of an engine.
+ */
+static const int garbageCollectionInterval = 16;
+
+/**
+ * @brief The JsTexGen::PooledEngine struct
+ *
+ * An engine that has evaluated the generator's script and is
+ * ready to have its generate function called.
+ */
+struct JsTexGen::PooledEngine {
+   QScriptEngine engine;
+   int numRuns = 0;
+};
+#endif
+
+#ifdef USE_QJSENGINE
+/**
+ * @brief newPixelView
+ * @param engine The engine to create the view in
+ * @param pixels The image's pixels
+ * @param numPixels Number of pixels in the image
+ * @param separateColorChannels True for one byte per channel, false for
+ *        one 32 bit value per pixel
+ * @param shared True to view the pixels' memory, false to view a copy
+ * @return A typed array over the pixels
+ *
+ * QJSEngine's ArrayBuffer shares the QByteArray's data, so a shared view
+ * lets the script write the image's memory directly without any copying.
+ * Source images belong to other nodes and are only handed out as copies,
+ * which is a single memcpy instead of one setProperty per element.
+ */
+static QScriptValue newPixelView(QScriptEngine& engine, TexturePixel* pixels,
+                                 quint32 numPixels, bool separateColorChannels,
+                                 bool shared)
+{
+   auto* data = reinterpret_cast<const char*>(pixels);
+   auto numBytes = static_cast<int>(numPixels * sizeof(TexturePixel));
+   QByteArray bytes = shared ? QByteArray::fromRawData(data, numBytes)
+                             : QByteArray(data, numBytes);
+   QScriptValue buffer = engine.toScriptValue(bytes);
+   QScriptValue view = engine.globalObject().property(separateColorChannels ? "Uint8Array" : "Uint32Array");
+   return view.callAsConstructor(QScriptValueList() << buffer);
+}
+#endif
+
 
 /**
  * @brief JsTexGen::JsTexGen
@@ -45,12 +97,14 @@
  * Creates the settings object based on the result.
  */
 JsTexGen::JsTexGen(const QString& jsContent)
-   : scriptContent(jsContent)
+   : scriptContent(jsContent),
+     scriptHash(QCryptographicHash::hash(jsContent.toUtf8(), QCryptographicHash::Sha1))
 {
    valid = false;
    description = "";
    numSlots = 0;
    separateColorChannels = false;
+   typedArrays = false;
 
 #ifndef DISABLE_JAVASCRIPT
    QScriptEngine jsEngine;
@@ -128,11 +182,212 @@ JsTexGen::JsTexGen(const QString& jsContent)
    if (!jsEngine.globalObject().property("separateColorChannels").isUndefined()) {
       separateColorChannels = jsEngine.globalObject().property("separateColorChannels").toBool();
    }
+   if (!jsEngine.globalObject().property("typedArrays").isUndefined()) {
+      typedArrays = jsEngine.globalObject().property("typedArrays").toBool();
+   }
    jsEngine.collectGarbage();
    valid = true;
 #endif
 }
 
+/**
+ * @brief JsTexGen::JsTexGen
+ * @param jsContent The script's content
+ * @param metadata The script's metadata, as returned by getMetadata
+ *
+ * Restores a generator from previously cached metadata without
+ * evaluating the script. The script is first evaluated when the
+ * generator is used.
+ */
+JsTexGen::JsTexGen(const QString& jsContent, const QJsonObject& metadata)
+   : scriptContent(jsContent),
+     scriptHash(QCryptographicHash::hash(jsContent.toUtf8(), QCryptographicHash::Sha1))
+{
+   valid = metadata.value("valid").toBool();
+   name = metadata.value("name").toString();
+   description = metadata.value("description").toString();
+   numSlots = metadata.value("numslots").toInt();
+   separateColorChannels = metadata.value("separatecolorchannels").toBool();
+   typedArrays = metadata.value("typedarrays").toBool();
+
+   QJsonObject settings = metadata.value("settings").toObject();
+   for (auto it = settings.constBegin(); it != settings.constEnd(); ++it) {
+      QJsonObject settingJson = it.value().toObject();
+      TextureGeneratorSetting newsetting;
+      newsetting.name = settingJson.value("name").toString();
+      newsetting.description = settingJson.value("description").toString();
+      newsetting.order = settingJson.value("order").toInt();
+      QString type = settingJson.value("type").toString();
+      if (type == "color") {
+         newsetting.defaultvalue = QVariant(QColor(settingJson.value("defaultvalue").toString()));
+      } else if (type == "int") {
+         newsetting.defaultvalue = QVariant(settingJson.value("defaultvalue").toInt());
+      } else if (type == "double") {
+         newsetting.defaultvalue = QVariant(settingJson.value("defaultvalue").toDouble());
+      }
+      if (settingJson.contains("min")) {
+         newsetting.min = settingJson.value("min").toVariant();
+      }
+      if (settingJson.contains("max")) {
+         newsetting.max = settingJson.value("max").toVariant();
+      }
+      configurables.insert(it.key(), newsetting);
+   }
+}
+
+/**
+ * @brief JsTexGen::getMetadata
+ * @return What was learned from evaluating the script, so the generator
+ *         can be recreated without evaluating it again.
+ */
+QJsonObject JsTexGen::getMetadata() const
+{
+   QJsonObject settings;
+   QMapIterator<QString, TextureGeneratorSetting> it(configurables);
+   while (it.hasNext()) {
+      it.next();
+      const TextureGeneratorSetting& setting = it.value();
+      QJsonObject settingJson;
+      settingJson.insert("name", setting.name);
+      settingJson.insert("description", setting.description);
+      settingJson.insert("order", setting.order);
+      switch (setting.defaultvalue.type()) {
+      case QVariant::Type::Color:
+         settingJson.insert("type", QString("color"));
+         settingJson.insert("defaultvalue", setting.defaultvalue.value<QColor>().name(QColor::HexArgb));
+         break;
+      case QVariant::Type::Int:
+         settingJson.insert("type", QString("int"));
+         settingJson.insert("defaultvalue", setting.defaultvalue.toInt());
+         break;
+      case QVariant::Type::Double:
+         settingJson.insert("type", QString("double"));
+         settingJson.insert("defaultvalue", setting.defaultvalue.toDouble());
+         break;
+      default:
+         break;
+      }
+      if (setting.min.isValid()) {
+         settingJson.insert("min", QJsonValue::fromVariant(setting.min));
+      }
+      if (setting.max.isValid()) {
+         settingJson.insert("max", QJsonValue::fromVariant(setting.max));
+      }
+      settings.insert(it.key(), settingJson);
+   }
+   QJsonObject metadata;
+   metadata.insert("valid", valid);
+   metadata.insert("name", name);
+   metadata.insert("description", description);
+   metadata.insert("numslots", numSlots);
+   metadata.insert("separatecolorchannels", separateColorChannels);
+   metadata.insert("typedarrays", typedArrays);
+   metadata.insert("settings", settings);
+   return metadata;
+}
+
+/**
+ * @brief JsTexGen::~JsTexGen
+ * Deletes the pooled engines. No renders can be running at this point,
+ * so the engines of other threads aren't in use either.
+ */
+JsTexGen::~JsTexGen()
+{
+#ifndef DISABLE_JAVASCRIPT
+   mutex.lockForWrite();
+   for (const QMetaObject::Connection& connection : threadConnections) {
+      QObject::disconnect(connection);
+   }
+   threadConnections.clear();
+   qDeleteAll(idleEngines);
+   idleEngines.clear();
+   mutex.unlock();
+#endif
+}
+
+#ifndef DISABLE_JAVASCRIPT
+/**
+ * @brief JsTexGen::acquireEngine
+ * @return An engine for one render, or nullptr if the script fails
+ *
+ * Engines are only ever used by the thread that created them. Takes the
+ * calling thread's idle engine, or creates a new one and evaluates the
+ * script in it. Every garbageCollectionInterval renders the engine's
+ * garbage is collected before it's handed out.
+ */
+JsTexGen::PooledEngine* JsTexGen::acquireEngine() const
+{
+   QThread* thread = QThread::currentThread();
+   mutex.lockForWrite();
+   PooledEngine* pooledEngine = idleEngines.take(thread);
+   if (!threadConnections.contains(thread)) {
+      // Delete the thread's engine on the thread itself when it finishes.
+      threadConnections.insert(thread, QObject::connect(thread, &QThread::finished, [this, thread]() {
+         dropThreadEngine(thread);
+      }));
+   }
+   mutex.unlock();
+   if (pooledEngine) {
+      if (pooledEngine->numRuns % garbageCollectionInterval == 0) {
+         pooledEngine->engine.collectGarbage();
+      }
+      return pooledEngine;
+   }
+   pooledEngine = new PooledEngine;
+   QScriptValue parseResult = pooledEngine->engine.evaluate(scriptContent);
+   if (parseResult.isError()) {
+      qDebug() << "Error!";
+      delete pooledEngine;
+      return nullptr;
+   }
+   return pooledEngine;
+}
+
+/**
+ * @brief JsTexGen::releaseEngine
+ * @param pooledEngine Engine returned by acquireEngine on this thread
+ *
+ * Keeps one idle engine per thread, any other engine is deleted.
+ */
+void JsTexGen::releaseEngine(PooledEngine* pooledEngine) const
+{
+   pooledEngine->numRuns++;
+   QThread* thread = QThread::currentThread();
+   mutex.lockForWrite();
+   if (!idleEngines.contains(thread)) {
+      idleEngines.insert(thread, pooledEngine);
+      pooledEngine = nullptr;
+   }
+   mutex.unlock();
+   delete pooledEngine;
+}
+
+/**
+ * @brief JsTexGen::dropThreadEngine
+ * @param thread The thread that is finishing
+ *
+ * Called on the finishing thread, so that the engine is deleted by the
+ * thread that owns it and isn't handed to a new thread at the same address.
+ */
+void JsTexGen::dropThreadEngine(QThread* thread) const
+{
+   mutex.lockForWrite();
+   PooledEngine* pooledEngine = idleEngines.take(thread);
+   threadConnections.remove(thread);
+   mutex.unlock();
+   delete pooledEngine;
+}
+#else
+JsTexGen::PooledEngine* JsTexGen::acquireEngine() const
+{
+   return nullptr;
+}
+
+void JsTexGen::releaseEngine(PooledEngine*) const {}
+
+void JsTexGen::dropThreadEngine(QThread*) const {}
+#endif
+
 /**
  * @brief JsTexGen::isValid
  * @return true if the instance is a valid TextureGenerator.
@@ -151,19 +406,21 @@ bool JsTexGen::isValid() {
  * The result image are returned from the JS file either as
  * an array with 32 bit RGBA pixels or as a JSON object
  * with each color in one position [r, g, b, a, r, g, b...].
+ * With separateColorChannels or typedArrays set in the script, and
+ * QJSEngine, the images are instead sent as Uint8Array or Uint32Array
+ * typed arrays, copies of the sources and a view over the destination.
  */
 void JsTexGen::generate(QSize size, TexturePixel* destimage,
                         QMap<int, TextureImagePtr> sourceimages,
                         TextureNodeSettings* settings) const
 {
 #ifndef DISABLE_JAVASCRIPT
-   mutex.lockForWrite();
-   QScriptEngine jsEngine;
-   QScriptValue parseResult = jsEngine.evaluate(scriptContent);
-   if (parseResult.isError()) {
-      qDebug() << "Error!";
+   PooledEngine* pooledEngine = acquireEngine();
+   if (!pooledEngine) {
+      memset(destimage, 0, size.width() * size.height() * sizeof(TexturePixel));
       return;
    }
+   QScriptEngine& jsEngine = pooledEngine->engine;
    QList<QString> keys = settings->keys();
    QListIterator<QString> listIterator(keys);
    QJsonObject settingsJson;
@@ -209,11 +466,28 @@ void JsTexGen::generate(QSize size, TexturePixel* destimage,
    if (separateColorChannels) {
       arraySize *= 4;
    }
+   // With typed arrays, the packed pixels are in the same order as in
+   // memory, ARGB, instead of RGBA.
+   bool argb = typedArrays && !separateColorChannels;
+#ifdef USE_QJSENGINE
+   // Typed arrays are copies of the source images and a view straight
+   // into the destination image's memory.
+   bool useViews = separateColorChannels || typedArrays;
+#else
+   bool useViews = false;
+#endif
 
    // Add all source images.
    QMapIterator<int, TextureImagePtr> sourceIterator(sourceimages);
    while (sourceIterator.hasNext()) {
       sourceIterator.next();
+#ifdef USE_QJSENGINE
+      if (useViews) {
+         args << newPixelView(jsEngine, sourceIterator.value()->getData(), imageSize,
+                              separateColorChannels, false);
+         continue;
+      }
+#endif
       QScriptValue srcArray = jsEngine.newArray(arraySize);
       if (separateColorChannels) {
          auto* dataptr = reinterpret_cast<uint8_t*>(sourceIterator.value()->getData());
@@ -223,31 +497,49 @@ void JsTexGen::generate(QSize size, TexturePixel* destimage,
       } else {
          auto* dataptr = sourceIterator.value()->getData();
          for (quint32 i = 0; i < arraySize; i++) {
-            srcArray.setProperty(i, dataptr[i].toRGBA());
+            srcArray.setProperty(i, argb ? dataptr[i].toARGB() : dataptr[i].toRGBA());
          }
       }
       args << srcArray;
    }
 
-   QScriptValue retArray = jsEngine.newArray(arraySize);
-   for (quint32 i = 0; i < arraySize; i++) {
-      retArray.setProperty(i, 0);
+   memset(destimage, 0, imageSize * sizeof(TexturePixel));
+   QScriptValue destArray;
+#ifdef USE_QJSENGINE
+   if (useViews) {
+      destArray = newPixelView(jsEngine, destimage, imageSize, separateColorChannels, true);
    }
-   jsEngine.globalObject().setProperty("dest", retArray);
+#endif
+   if (!useViews) {
+      destArray = jsEngine.newArray(arraySize);
+      for (quint32 i = 0; i < arraySize; i++) {
+         destArray.setProperty(i, 0);
+      }
+   }
+   jsEngine.globalObject().setProperty("dest", destArray);
+   // The pooled engine outlives this render, so it must not keep any
+   // references to destimage or the source copies once it's released.
+   auto release = [&]() {
+      jsEngine.globalObject().setProperty("dest", QScriptValue());
+      args.clear();
+      destArray = QScriptValue();
+      releaseEngine(pooledEngine);
+   };
    QScriptValue retVal;
+   QScriptValue retArray;
    try {
       retArray = jsEngine.globalObject().property("generate").call(SCRIPT_PARAMS);
       if (retArray.isError()) {
          qDebug() << "Error!";
          qDebug() << retVal.toString();
          memset(destimage, 0, imageSize * sizeof(TexturePixel));
-         mutex.unlock();
+         release();
          return;
       }
    } catch (...) {
       qDebug() << "Exception";
       memset(destimage, 0, imageSize * sizeof(TexturePixel));
-      mutex.unlock();
+      release();
       return;
    }
    auto* dstchar = reinterpret_cast<unsigned char*>(destimage);
@@ -259,6 +551,16 @@ void JsTexGen::generate(QSize size, TexturePixel* destimage,
       for (int i = 0; i < arraySize; i++) {
          dstchar[i] = static_cast<unsigned char>(imgArray[i].toInt(0));
       }
+   } else if (useViews && retArray.strictlyEquals(destArray)) {
+#ifdef USE_QJSENGINE
+      // The script has written straight into destimage, unless the
+      // engine made its own copy of the memory.
+      QByteArray written = jsEngine.fromScriptValue<QByteArray>(destArray.property("buffer"));
+      if (written.constData() != reinterpret_cast<const char*>(destimage)) {
+         memcpy(destimage, written.constData(),
+                qMin(static_cast<size_t>(written.size()), imageSize * sizeof(TexturePixel)));
+      }
+#endif
    } else if (separateColorChannels) {
       for (quint32 i = 0; i < arraySize; i++) {
          dstchar[i] = static_cast<unsigned char>(retArray.property(i).toUInt16());
@@ -266,14 +568,17 @@ void JsTexGen::generate(QSize size, TexturePixel* destimage,
    } else {
       for (quint32 i = 0; i < imageSize; i++) {
          quint32 color = retArray.property(i).toUInt32();
+         if (argb) {
+            color = (color << 8) | (color >> 24);
+         }
          destimage[i].r = static_cast<unsigned char>((color) >> 24);
          destimage[i].g = static_cast<unsigned char>((color << 8) >> 24);
          destimage[i].b = static_cast<unsigned char>((color << 16) >> 24);
          destimage[i].a = static_cast<unsigned char>((color << 24) >> 24);
       }
    }
-   jsEngine.collectGarbage();
-   mutex.unlock();
+   retArray = QScriptValue();
+   release();
 #else
    Q_UNUSED(size);
    Q_UNUSED(destimage);
@@ -291,6 +596,38 @@ void GeneratorFileFinder::abort()
    aborted = true;
 }
 
+/**
+ * @brief GeneratorFileFinder::loadMetadataCache
+ * @return The cached metadata of previously scanned scripts, by path.
+ */
+QJsonObject GeneratorFileFinder::loadMetadataCache() const
+{
+   QFile cacheFile(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                   + "/jsgenerators.json");
+   if (!cacheFile.open(QIODevice::ReadOnly)) {
+      return QJsonObject();
+   }
+   return QJsonDocument::fromJson(cacheFile.readAll()).object();
+}
+
+/**
+ * @brief GeneratorFileFinder::saveMetadataCache
+ * @param cache The metadata of the scripts found in the last scan, by path.
+ */
+void GeneratorFileFinder::saveMetadataCache(const QJsonObject& cache) const
+{
+   QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+   if (cacheDir.isEmpty() || !QDir().mkpath(cacheDir)) {
+      return;
+   }
+   QSaveFile cacheFile(cacheDir + "/jsgenerators.json");
+   if (!cacheFile.open(QIODevice::WriteOnly)) {
+      return;
+   }
+   cacheFile.write(QJsonDocument(cache).toJson(QJsonDocument::Compact));
+   cacheFile.commit();
+}
+
 /**
  * @brief GeneratorFileFinder::scanDirectory
  * @param basepath Directory to search recursively.
@@ -298,6 +635,9 @@ void GeneratorFileFinder::abort()
  * Scans the selected directory and its sub-directories for Javascript files.
  * Files found are then checked whether they are TextureGenerator classes, and
  * if so are packaged into a JsTexGen instance and emitted as a signal.
+ * Scripts whose path, modification time and content are unchanged since
+ * they were last scanned are recreated from the metadata cache instead
+ * of being evaluated.
  */
 void GeneratorFileFinder::scanDirectory(QString basepath) {
    aborted = false;
@@ -309,10 +649,29 @@ void GeneratorFileFinder::scanDirectory(QString basepath) {
       emit scanFinished();
       return;
    }
+   QJsonObject oldCache = loadMetadataCache();
+   // Entries under the scanned directory are only kept for the files found
+   // in this scan, so deleted or moved scripts are dropped from the cache.
+   // The entries of other directories are kept, so switching back to a
+   // previous directory doesn't evaluate all of its scripts again.
+   QString scannedPrefix = dir.absolutePath() + "/";
+   QJsonObject newCache;
+   for (auto it = oldCache.constBegin(); it != oldCache.constEnd(); ++it) {
+      if (!it.key().startsWith(scannedPrefix)) {
+         newCache.insert(it.key(), it.value());
+      }
+   }
    QDirIterator iterator(basepath, QDirIterator::Subdirectories);
    while (iterator.hasNext()) {
       if (aborted) {
-         // Scanning was aborted by the caller
+         // Scanning was aborted by the caller. Keep the entries of the
+         // files that weren't reached.
+         for (auto it = oldCache.constBegin(); it != oldCache.constEnd(); ++it) {
+            if (!newCache.contains(it.key())) {
+               newCache.insert(it.key(), it.value());
+            }
+         }
+         saveMetadataCache(newCache);
          emit scanFinished();
          return;
       }
@@ -323,10 +682,26 @@ void GeneratorFileFinder::scanDirectory(QString basepath) {
          if (!scriptFile.open(QIODevice::ReadOnly)) {
             return;
          }
-         QTextStream stream(&scriptFile);
-         QString contents = stream.readAll();
+         QByteArray rawContents = scriptFile.readAll();
          scriptFile.close();
-         auto* newTexGen = new JsTexGen(contents);
+         QString contents = QTextStream(&rawContents).readAll();
+         qint64 modified = iterator.fileInfo().lastModified().toMSecsSinceEpoch();
+         QString hash = QCryptographicHash::hash(rawContents, QCryptographicHash::Sha1).toHex();
+
+         JsTexGen* newTexGen;
+         QJsonObject cached = oldCache.value(filename).toObject();
+         if (cached.value("modified").toString().toLongLong() == modified &&
+             cached.value("hash").toString() == hash) {
+            newTexGen = new JsTexGen(contents, cached.value("metadata").toObject());
+            newCache.insert(filename, cached);
+         } else {
+            newTexGen = new JsTexGen(contents);
+            QJsonObject entry;
+            entry.insert("modified", QString::number(modified));
+            entry.insert("hash", hash);
+            entry.insert("metadata", newTexGen->getMetadata());
+            newCache.insert(filename, entry);
+         }
          if (newTexGen->isValid()) {
             emit generatorFound(newTexGen);
          } else {
@@ -334,6 +709,7 @@ void GeneratorFileFinder::scanDirectory(QString basepath) {
          }
       }
    }
+   saveMetadataCache(newCache);
    emit scanFinished();
 }
 
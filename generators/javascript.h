@@ -9,11 +9,14 @@
 #define JSTEXGENMANAGER_H
 
 #include "texturegenerator.h"
+#include <QHash>
+#include <QJsonObject>
 #include <QObject>
 #include <QReadWriteLock>
 
 class GeneratorFileFinder;
 class JsTexGen;
+class QThread;
 class TextureProject;
 
 /**
@@ -54,7 +57,8 @@ class JsTexGen : public TextureGenerator
 {
 public:
    explicit JsTexGen(const QString& jsContent);
-    ~JsTexGen() override = default;
+   JsTexGen(const QString& jsContent, const QJsonObject& metadata);
+   ~JsTexGen() override;
    void generate(QSize size, TexturePixel* destimage,
                  QMap<int, TextureImagePtr> sourceimages,
                  TextureNodeSettings* settings) const override;
@@ -65,16 +69,27 @@ public:
    QString getDescription() const override { return description; }
    TextureGenerator::Type getType() const override { return TextureGenerator::Type::Generator; }
    bool isValid();
+   QJsonObject getMetadata() const;
+   QByteArray getCacheKey() const override { return TextureGenerator::getCacheKey() + scriptHash; }
 
 private:
+   struct PooledEngine;
+   PooledEngine* acquireEngine() const;
+   void releaseEngine(PooledEngine* pooledEngine) const;
+   void dropThreadEngine(QThread* thread) const;
+
    TextureGeneratorSettings configurables;
    QString name;
    QString description;
    QString scriptContent;
+   QByteArray scriptHash;
    mutable QReadWriteLock mutex;
+   mutable QHash<QThread*, PooledEngine*> idleEngines;
+   mutable QHash<QThread*, QMetaObject::Connection> threadConnections;
    int numSlots;
    bool valid;
    bool separateColorChannels;
+   bool typedArrays;
 };
 
 /**
@@ -90,6 +105,9 @@ signals:
    void scanFinished();
    void generatorFound(JsTexGen* filename);
 private:
+   QJsonObject loadMetadataCache() const;
+   void saveMetadataCache(const QJsonObject& cache) const;
+
    bool aborted;
 };
 
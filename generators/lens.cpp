@@ -5,8 +5,8 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/warpsampler.h"
 #include "lens.h"
-#include <QPoint>
 #include <cmath>
 
 LensTextureGenerator::LensTextureGenerator()
@@ -42,6 +42,8 @@ LensTextureGenerator::LensTextureGenerator()
    strength.max = QVariant(300);
    strength.order = 3;
    configurables.insert("strength", strength);
+
+   WarpSampler::addSettings(configurables, 4);
 }
 
 
@@ -63,51 +65,29 @@ void LensTextureGenerator::generate(QSize size,
    }
    TexturePixel* sourceimage = sourceimages.value(0).data()->getData();
 
-   memcpy(destimage, sourceimage, size.width() * size.height() * sizeof(TexturePixel));
-
    if (lenssize % 2) {
       lenssize += 1;
    }
-   QPoint* lens = new QPoint[lenssize * lenssize];
    int r = lenssize / 2;
+   int centerx = size.width() / 2 + offsetleft;
+   int centery = size.height() / 2 + offsettop;
+   float radiusSquared = r * r;
+   float strengthSquared = strength * strength;
+   float lensStrength = strength;
 
-   for (int y = 0; y < (lenssize >> 1); y++) {
-      for (int x = 0; x < (lenssize >> 1); x++) {
-         int ix = 0;
-         int iy = 0;
-         if ((x * x + y * y) < (r * r)) {
-            double shift = (double) strength /
-                  sqrt(strength * strength - (x * x + y * y - r * r));
-            ix = x * shift - x;
-            iy = y * shift - y;
-         }
-         lens[lenssize * (lenssize / 2 - y) + lenssize / 2 - x] = QPoint(-ix, -iy);
-         lens[lenssize * (lenssize / 2 + y) + lenssize / 2 + x] = QPoint(ix, iy);
-         lens[lenssize * (lenssize / 2 + y) + lenssize / 2 - x] = QPoint(-ix, iy);
-         lens[lenssize * (lenssize / 2 - y) + lenssize / 2 + x] = QPoint(ix, -iy);
-      }
-   }
-   for (int y = 0; y < lenssize; y++) {
-      int ypos = y + size.height() / 2 + offsettop - lenssize / 2;
-      for (int x = 0; x < lenssize; x++) {
-         int xpos = x + size.width() / 2 + offsetleft - lenssize / 2;
-         int destpos = ypos * size.width() + xpos;
-         if (xpos >= 0 && xpos < size.width() && ypos >= 0 && ypos < size.height()) {
-            int sourcex = xpos + lens[y * lenssize + x].x();
-            if (sourcex < 0) {
-               sourcex += size.width();
-            } else {
-               sourcex = sourcex % size.width();
-            }
-            int sourcey = ypos + lens[y * lenssize + x].y();
-            if (sourcey < 0) {
-               sourcey += size.height();
-            } else {
-               sourcey = sourcey % size.height();
-            }
-            destimage[destpos] = sourceimage[sourcey * size.width() + sourcex];
+   // Inside the lens the pixels are pushed out from its center, the
+   // rest of the image is left as it is.
+   WarpSampler::warp(size, destimage, sourceimage, [=](int y, int width, float* sourceX, float* sourceY) {
+      float dy = y - centery;
+      for (int x = 0; x < width; x++) {
+         float dx = x - centerx;
+         float distanceSquared = dx * dx + dy * dy;
+         float shift = 1;
+         if (distanceSquared < radiusSquared) {
+            shift = lensStrength / std::sqrt(strengthSquared - (distanceSquared - radiusSquared));
          }
+         sourceX[x] = x + dx * shift - dx;
+         sourceY[x] = y + dy * shift - dy;
       }
-   }
-   delete[] lens;
+   }, WarpSampler::getEdges(settings), WarpSampler::getFilter(settings));
 }
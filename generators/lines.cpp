@@ -5,6 +5,7 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/shaperasterizer.h"
 #include "lines.h"
 #include <QColor>
 #include <QtMath>
@@ -73,43 +74,32 @@ void LinesTextureGenerator::generate(QSize size,
       memset(destimage, 0, size.width() * size.height() * sizeof(TexturePixel));
    }
 
-   TexturePixel filler(color.red(), color.green(), color.blue(), 255);
+   if (lineheight <= 0) {
+      return;
+   }
+   // Angles over 90 degrees are drawn mirrored.
    bool invert = false;
    if (angle > 90) {
       invert = true;
       angle = 180 - angle;
    }
    angle = (angle / 180.0) * ((double) M_PI);
-   double x1 = 0;
-   double y1 = -10000;
-   double x1rot = (x1 * cos(angle)) - (y1 * sin(angle));
-   double y1rot = (y1 * cos(angle)) + (x1 * sin(angle));
-   x1 = x1rot;
-   y1 = y1rot;
-   double x2 = -x1;
-   double y2 = -y1;
-   for (int y = 0; y < size.height(); y++) {
-      for (int x = 0; x < size.width(); x++) {
-         double x3 = x;
-         double y3 = y;
-         double x4 = -10000;
-         double y4 = y;
-         double x4rot = ((x4 - x3) * cos(angle)) - ((y4 - y3) * sin(angle)) + x3;
-         double y4rot = ((y4 - y3) * cos(angle)) + ((x4 - x3) * sin(angle)) + y3;
-         x4 = x4rot;
-         y4 = y4rot;
-         double intersection_x = ((x2 * y1 - x1 * y2) * (x4 - x) - (x4 * y - x * y4) * (x2 - x1)) /
-               ((x2 - x1) * (y4 - y) - (x4 - x) * (y2 - y1));
-         double intersection_y = ((x2 * y1 - x1 * y2) * (y4 - y) - (x4 * y - x * y4) * (y2 - y1)) /
-               ((x2 - x1) * (y4 - y) - (x4 - x) * (y2 - y1));
-         int distance = sqrt((x - intersection_x) * (x - intersection_x) + (y - intersection_y) * (y - intersection_y));
-         if (((distance - offset) % (lineheight + spacing)) > spacing) {
-            if (invert) {
-               destimage[y * size.width() + size.width() - x - 1] = filler;
-            } else {
-               destimage[y * size.width() + x] = filler;
-            }
-         }
+   // The lines are parallel to a line through the origin at the given
+   // angle, the distance to it is x * cos(angle) + y * sin(angle).
+   float cosAngle = cos(angle);
+   float sinAngle = sin(angle);
+   float period = lineheight + spacing;
+   int width = size.width();
+
+   ShapeRasterizer::fill(size, QRect(QPoint(0, 0), size), destimage, color,
+                         [=](int y, int startX, int count, float* coverage) {
+      float rowDistance = y * sinAngle;
+      for (int i = 0; i < count; i++) {
+         int x = invert ? width - 1 - (startX + i) : startX + i;
+         float distance = std::fabs(x * cosAngle + rowDistance) - offset;
+         float lineStart = std::floor(distance / period) * period + spacing;
+         coverage[i] = ShapeRasterizer::spanCoverage(distance - 0.5f, lineStart, lineStart + lineheight) +
+                       ShapeRasterizer::spanCoverage(distance - 0.5f, lineStart - period, lineStart - spacing);
       }
-   }
+   });
 }
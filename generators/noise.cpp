@@ -5,15 +5,12 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/counterrandom.h"
 #include "noise.h"
 #include <QColor>
 #include <QImage>
 #include <QPainter>
-#include <QtGlobal>
 #include <QtMath>
-#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
-#include <QRandomGenerator>
-#endif
 
 NoiseTextureGenerator::NoiseTextureGenerator()
 {
@@ -99,7 +96,7 @@ void NoiseTextureGenerator::generate(QSize size,
    QColor color = settings->value("color").value<QColor>();
    int alphamin = settings->value("alphamin").toInt();
    int alphamax = settings->value("alphamax").toInt();
-   int randomizer = settings->value("randomizer").toInt();
+   quint32 randomizer = settings->value("randomizer").toUInt();
    int width = settings->value("width").toInt();
    int height = settings->value("height").toInt();
    int numpoints = settings->value("numpoints").toInt();
@@ -120,37 +117,22 @@ void NoiseTextureGenerator::generate(QSize size,
 
    if (width > 0 && height > 0) {
       TexturePixel baseColor(color.red(), color.green(), color.blue());
-#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
-      int alpharange = (alphamax - alphamin + 1);
-      srand(randomizer);
-#else
-      QRandomGenerator random(randomizer);
-#endif
       QImage tempimage = QImage(width, height, QImage::Format_ARGB32);
       TexturePixel* bufferImage = (TexturePixel*) tempimage.bits();
       if (!settings->value("scatter").toBool()) {
-         for (int i = 0; i < width * height; i++) {
-            bufferImage[i] = baseColor;
-#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
-            bufferImage[i].a = alphamin + (qrand() % alpharange);
-#else
-            bufferImage[i].a = random.bounded(alphamin, alphamax + 1);
-#endif
+         for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+               bufferImage[y * width + x] = baseColor;
+               bufferImage[y * width + x].a = CounterRandom::bounded(alphamin, alphamax + 1, randomizer, x, y);
+            }
          }
       } else {
+         // Point i always lands on the same pixel, whatever the number of points.
          memset(bufferImage, 0, width * height * sizeof(TexturePixel));
          for (int i = 0; i < numpoints; i++) {
-#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
-            int index = qrand() % (width * height);
-#else
-            int index = random.bounded(width * height);
-#endif
+            int index = CounterRandom::bounded(0, width * height, randomizer, i, 0, 0);
             bufferImage[index] = baseColor;
-#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
-            bufferImage[index].a = alphamin + (qrand() % alpharange);
-#else
-            bufferImage[index].a = random.bounded(alphamin, alphamax + 1);
-#endif
+            bufferImage[index].a = CounterRandom::bounded(alphamin, alphamax + 1, randomizer, i, 0, 1);
          }
       }
       Qt::TransformationMode transformationMode = Qt::FastTransformation;
@@ -5,9 +5,34 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/parallelbands.h"
 #include "normalmap.h"
-#include <QVector3D>
+#include <QStringList>
+#include <cmath>
 
+NormalMapTextureGenerator::NormalMapTextureGenerator()
+{
+   QStringList edgeModes;
+   edgeModes.append("Wrap");
+   edgeModes.append("Clamp");
+   TextureGeneratorSetting edges;
+   edges.name = "Edges";
+   edges.description = "How the pixels outside of the image are read";
+   edges.defaultvalue = QVariant(edgeModes);
+   edges.order = 1;
+   configurables.insert("edges", edges);
+}
+
+
+/**
+ * @brief NormalMapTextureGenerator::generate
+ *
+ * The summed red, green and blue values are used as the height, computed
+ * once into a 16 bit plane. The Sobel operator is split into a vertical
+ * pass per row, giving the smoothed and the differentiated columns, and a
+ * horizontal pass combining them, all in integers. Only the normalization
+ * is done in float.
+ */
 void NormalMapTextureGenerator::generate(QSize size,
                                          TexturePixel* destimage,
                                          QMap<int, TextureImagePtr> sourceimages,
@@ -16,38 +41,63 @@ void NormalMapTextureGenerator::generate(QSize size,
    if (!settings || !destimage || !size.isValid()) {
       return;
    }
-
-   memset(destimage, 255, size.width() * size.height() * sizeof(TexturePixel));
-
    if (!sourceimages.contains(0)) {
+      memset(destimage, 255, size.width() * size.height() * sizeof(TexturePixel));
       return;
    }
-   TexturePixel* sourceImage = sourceimages.value(0)->getData();
-
-   for (int y = 1; y < size.height() - 1; y++) {
-      for (int x = 1; x < size.width() - 1; x++) {
-         int pixelpos = y * size.width() + x;
-         double topleft = sourceImage[(y - 1) * size.width() + x - 1].intensity();
-         double topmiddle = sourceImage[(y - 1) * size.width() + x].intensity();
-         double topright = sourceImage[(y - 1) * size.width() + x + 1].intensity();
-         double middleleft = sourceImage[y * size.width() + x - 1].intensity();
-         double middleright = sourceImage[y * size.width() + x + 1].intensity();
-         double lowerleft = sourceImage[(y + 1) * size.width() + x - 1].intensity();
-         double lowermiddle = sourceImage[(y + 1) * size.width() + x].intensity();
-         double lowerright = sourceImage[(y + 1) * size.width() + x + 1].intensity();
-
-         double pStrength = 2;
+   const TexturePixel* sourceImage = sourceimages.value(0)->getData();
+   int width = size.width();
+   int height = size.height();
+   bool wrap = settings->value("edges").toString() != "Clamp";
 
-         const double dX = (topright + 2.0 * middleright + lowerright) - (topleft + 2.0 * middleleft + lowerleft);
-         const double dY = (lowerleft + 2.0 * lowermiddle + lowerright) - (topleft + 2.0 * topmiddle + topright);
-         const double dZ = 1.0 / pStrength;
+   auto* heights = new quint16[width * height];
+   ParallelBands::run(height, [=](int startY, int endY) {
+      for (int i = startY * width; i < endY * width; i++) {
+         heights[i] = sourceImage[i].r + sourceImage[i].g + sourceImage[i].b;
+      }
+   });
 
-         QVector3D vect(dX, dY, dZ);
-         vect.normalize();
+   // The intensities were the heights divided by 765 and the z component
+   // was 0.5, so after scaling everything by 2 * 765 z is 765.
+   const float dZ = 765;
 
-         destimage[pixelpos].r = (vect.x() + 1.0) * 127.5;
-         destimage[pixelpos].g = (vect.y() + 1.0) * 127.5;
-         destimage[pixelpos].b = (vect.z() + 1.0) * 127.5;
+   ParallelBands::run(height, [=](int startY, int endY) {
+      // One extra column on each side.
+      auto* smoothed = new qint32[width + 2];
+      auto* differentiated = new qint32[width + 2];
+      auto* columns = new int[width + 2];
+      for (int x = -1; x <= width; x++) {
+         if (wrap) {
+            columns[x + 1] = (x + width) % width;
+         } else {
+            columns[x + 1] = qBound(0, x, width - 1);
+         }
       }
-   }
+      for (int y = startY; y < endY; y++) {
+         int up = wrap ? (y + height - 1) % height : qMax(y - 1, 0);
+         int down = wrap ? (y + 1) % height : qMin(y + 1, height - 1);
+         const quint16* upRow = heights + up * width;
+         const quint16* middleRow = heights + y * width;
+         const quint16* downRow = heights + down * width;
+         for (int x = 0; x < width + 2; x++) {
+            int column = columns[x];
+            smoothed[x] = upRow[column] + 2 * middleRow[column] + downRow[column];
+            differentiated[x] = downRow[column] - upRow[column];
+         }
+         TexturePixel* destRow = destimage + y * width;
+         for (int x = 0; x < width; x++) {
+            float dX = 2 * (smoothed[x + 2] - smoothed[x]);
+            float dY = 2 * (differentiated[x] + 2 * differentiated[x + 1] + differentiated[x + 2]);
+            float invLength = 1.0f / std::sqrt(dX * dX + dY * dY + dZ * dZ);
+            destRow[x].r = static_cast<unsigned char>((dX * invLength + 1.0f) * 127.5f);
+            destRow[x].g = static_cast<unsigned char>((dY * invLength + 1.0f) * 127.5f);
+            destRow[x].b = static_cast<unsigned char>((dZ * invLength + 1.0f) * 127.5f);
+            destRow[x].a = 255;
+         }
+      }
+      delete[] smoothed;
+      delete[] differentiated;
+      delete[] columns;
+   });
+   delete[] heights;
 }
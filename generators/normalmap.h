@@ -16,7 +16,7 @@
 class NormalMapTextureGenerator : public TextureGenerator
 {
 public:
-   NormalMapTextureGenerator() = default;
+   NormalMapTextureGenerator();
    ~NormalMapTextureGenerator() override = default;
    void generate(QSize size,
                  TexturePixel* destimage,
@@ -25,7 +25,7 @@ public:
    int getNumSourceSlots() const override { return 1; }
    QString getName() const override { return QString("Normal-map"); }
    const TextureGeneratorSettings& getSettings() const override { return configurables; }
-   QString getDescription() const override { return QString("Blurs the source image."); }
+   QString getDescription() const override { return QString("Creates a normal map from the source's intensity."); }
    TextureGenerator::Type getType() const override { return TextureGenerator::Type::Filter; }
 
 private:
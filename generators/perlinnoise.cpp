@@ -5,8 +5,10 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/parallelbands.h"
 #include "perlinnoise.h"
 #include <QColor>
+#include <QVector>
 #include <QtMath>
 #include <cmath>
 
@@ -51,31 +53,84 @@ PerlinNoiseTextureGenerator::PerlinNoiseTextureGenerator()
 }
 
 
-double PerlinNoiseTextureGenerator::findnoise2(double x, double y) const
+/**
+ * @brief valueNoise
+ * @param n Lattice point, x + y * 57
+ * @return pseudo random value in the range [-1, 1]
+ *
+ * Integer hash for the lattice points. Unsigned arithmetic gives the
+ * same bits as the wrapping signed version but is well defined.
+ */
+static inline float valueNoise(quint32 n)
 {
-   int n = (int) x + (int) y * 57;
    n = (n << 13) ^ n;
-   int nn = (n * (n * n * 60493 + 19990303) + 1376312589)&  0x7fffffff;
-   return 1.0 - ((double) nn / 1073741824.0);
+   quint32 nn = (n * (n * n * 60493 + 19990303) + 1376312589) & 0x7fffffff;
+   return 1.0f - static_cast<float>(static_cast<qint32>(nn)) * (1.0f / 1073741824.0f);
 }
 
 
-double PerlinNoiseTextureGenerator::noise(double x, double y) const
+/**
+ * @brief interpolationWeight
+ * @param t Fraction in the range [0, 1)
+ * @return (1 - cos(t * pi)) / 2
+ *
+ * Written as 0.5 + 0.5 * sin(pi * (t - 0.5)) with a polynomial for sin,
+ * accurate to within 4e-6, so that the loops calling it can be vectorized.
+ */
+static inline float interpolationWeight(float t)
 {
-   double s = findnoise2((int) x, (int) y);
-   double t = findnoise2((int) x + 1, (int) y);
-   double u = findnoise2((int) x, (int) y + 1);
-   double v = findnoise2((int) x + 1, (int) y + 1);
-   double int1 = interpolate(s, t, x - (int) x);
-   double int2 = interpolate(u, v, x - (int) x);
-   return interpolate(int1, int2, y - (int) y);
+   float z = static_cast<float>(M_PI) * (t - 0.5f);
+   float z2 = z * z;
+   float sinz = z * (1.0f + z2 * (-1.0f / 6 + z2 * (1.0f / 120 + z2 * (-1.0f / 5040 + z2 * (1.0f / 362880)))));
+   return 0.5f + 0.5f * sinz;
 }
 
 
-double PerlinNoiseTextureGenerator::interpolate(double a, double b, double x) const
+/**
+ * @brief PerlinNoiseTextureGenerator::addOctave
+ * @param noiseRow Accumulated noise for one row
+ * @param width Number of pixels in the row
+ * @param startX Noise coordinate of the first pixel
+ * @param stepX Noise coordinate step between pixels
+ * @param posY Noise coordinate of the row
+ * @param amplitude The octave's amplitude
+ *
+ * Adds one octave of interpolated value noise to a row. The pixels are
+ * handled in chunks, first splitting the coordinates into lattice cells and
+ * fractions in double precision, as the coordinates are too large for float,
+ * and then hashing and interpolating the whole chunk in float.
+ */
+void PerlinNoiseTextureGenerator::addOctave(float* noiseRow, int width, double startX, double stepX,
+                                            double posY, float amplitude) const
 {
-   double f = (1.0 - cos(x * 3.1415927)) * 0.5;
-   return a * (1.0 - f) + b * f;
+   const int chunkSize = 64;
+   quint32 cellX[chunkSize];
+   float weightX[chunkSize];
+
+   auto cellY = static_cast<qint32>(posY);
+   float weightY = interpolationWeight(static_cast<float>(posY - cellY));
+   quint32 row0 = static_cast<quint32>(cellY) * 57;
+   quint32 row1 = static_cast<quint32>(cellY + 1) * 57;
+
+   for (int x0 = 0; x0 < width; x0 += chunkSize) {
+      int count = qMin(chunkSize, width - x0);
+      for (int i = 0; i < count; i++) {
+         double posX = startX + (x0 + i) * stepX;
+         auto cell = static_cast<qint32>(posX);
+         cellX[i] = static_cast<quint32>(cell);
+         weightX[i] = interpolationWeight(static_cast<float>(posX - cell));
+      }
+      float* out = noiseRow + x0;
+      for (int i = 0; i < count; i++) {
+         float s = valueNoise(cellX[i] + row0);
+         float t = valueNoise(cellX[i] + 1 + row0);
+         float u = valueNoise(cellX[i] + row1);
+         float v = valueNoise(cellX[i] + 1 + row1);
+         float int1 = s + (t - s) * weightX[i];
+         float int2 = u + (v - u) * weightX[i];
+         out[i] += (int1 + (int2 - int1) * weightY) * amplitude;
+      }
+   }
 }
 
 
@@ -94,36 +149,50 @@ void PerlinNoiseTextureGenerator::generate(QSize size, TexturePixel* destimage,
    double randomizer = settings->value("randomizer").toDouble() * 1000;
    double xFactor = (double) 500 / size.width();
    double yFactor = (double) 500 / size.height();
-   bool blend = false;
    TexturePixel* sourceImg = nullptr;
    if (sourceimages.contains(0)) {
       sourceImg = sourceimages.value(0)->getData();
-      blend = true;
    }
-   for (int y = 0; y < size.height(); y++) {
-      for (int x = 0; x < size.width(); x++) {
-         double getnoise = 0;
-         int thisPos = y * size.width() + x;
-
-         for (int currOctave = 0; currOctave < numOctaves - 1; currOctave++) {
-            double frequency = pow(2, currOctave); //This increases the frequency with every loop of the octave.
-            double amplitude = pow(persistence, currOctave);//This decreases the amplitude with every loop of the octave.
-            getnoise += noise(randomizer + static_cast<double>(x) * xFactor * frequency / zoom,
-                              randomizer + static_cast<double>(y) * yFactor / zoom * frequency) * amplitude;
-         }
-         auto pixelColor = static_cast<int>((getnoise * 128.0) + 128.0);
-         if (pixelColor > 255) {
-            pixelColor = 255;
+
+   // The frequency doubles and the amplitude decreases with every octave.
+   int octaves = qMax(numOctaves - 1, 0);
+   QVector<double> stepX(octaves);
+   QVector<double> stepY(octaves);
+   QVector<float> amplitude(octaves);
+   for (int currOctave = 0; currOctave < octaves; currOctave++) {
+      double frequency = pow(2, currOctave);
+      stepX[currOctave] = xFactor * frequency / zoom;
+      stepY[currOctave] = yFactor / zoom * frequency;
+      amplitude[currOctave] = pow(persistence, currOctave);
+   }
+
+   // Every pixel only depends on its own coordinates, so the result
+   // is the same regardless of how the rows are split between threads.
+   int width = size.width();
+   ParallelBands::run(size.height(), [&](int startY, int endY) {
+      auto* noiseRow = new float[width];
+      for (int y = startY; y < endY; y++) {
+         memset(noiseRow, 0, width * sizeof(float));
+         for (int currOctave = 0; currOctave < octaves; currOctave++) {
+            addOctave(noiseRow, width, randomizer, stepX[currOctave],
+                      randomizer + y * stepY[currOctave], amplitude[currOctave]);
          }
-         if (pixelColor < 0) {
-            pixelColor = 0;
+         for (int x = 0; x < width; x++) {
+            int thisPos = y * width + x;
+            int pixelColor = qBound(0, static_cast<int>((noiseRow[x] * 128.0f) + 128.0f), 255);
+            double fraction = pixelColor / 255.0;
+            double negVal = 1 - fraction;
+            if (sourceImg) {
+               destimage[thisPos].r = qBound(0, static_cast<int>(fraction * color.red() + negVal * sourceImg[thisPos].r), 255);
+               destimage[thisPos].g = qBound(0, static_cast<int>(fraction * color.green() + negVal * sourceImg[thisPos].g), 255);
+               destimage[thisPos].b = qBound(0, static_cast<int>(fraction * color.blue() + negVal * sourceImg[thisPos].b), 255);
+            } else {
+               destimage[thisPos].r = qBound(0, static_cast<int>(fraction * color.red()), 255);
+               destimage[thisPos].g = qBound(0, static_cast<int>(fraction * color.green()), 255);
+               destimage[thisPos].b = qBound(0, static_cast<int>(fraction * color.blue()), 255);
+            }
          }
-         double fraction = (static_cast<double>(pixelColor) / 255.0);
-         double negVal = 1 - (static_cast<double>(pixelColor) / 255.0);
-
-         destimage[thisPos].r = qMin(qMax((int) (fraction * (float) color.red() + (blend ? (negVal * (float) sourceImg[thisPos].r) : 0)), 0), 255);
-         destimage[thisPos].g = qMin(qMax((int) (fraction * (float) color.green() + (blend ? (negVal * (float) sourceImg[thisPos].g) : 0)), 0), 255);
-         destimage[thisPos].b = qMin(qMax((int) (fraction * (float) color.blue() + (blend ? (negVal * (float) sourceImg[thisPos].b) : 0)), 0), 255);
       }
-   }
+      delete[] noiseRow;
+   });
 }
@@ -29,9 +29,8 @@ public:
    TextureGenerator::Type getType() const override { return TextureGenerator::Type::Generator; }
 
 private:
-   double noise(double x, double y) const;
-   double findnoise2(double x,double y) const;
-   double interpolate(double a, double b, double x) const;
+   void addOctave(float* noiseRow, int width, double startX, double stepX,
+                  double posY, float amplitude) const;
 
    TextureGeneratorSettings configurables;
 };
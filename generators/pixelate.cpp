@@ -62,48 +62,59 @@ void PixelateTextureGenerator::generate(QSize size,
       return;
    }
    TexturePixel* sourceImage = sourceimages.value(0).data()->getData();
+   const auto* src = reinterpret_cast<const unsigned char*>(sourceImage);
+   int rowLength = size.width() * 4;
+   quint64 totalPixels = static_cast<quint64>(width) * height;
+
+   // For every row of blocks the source rows are summed per column once, and
+   // prefix sums over those column sums then give each block's total with a
+   // few lookups. Blocks wrap around the image edges.
+   auto* columnSums = new quint64[rowLength];
+   auto* prefixSums = new quint64[rowLength + 4];
+   const quint64* rowTotal = prefixSums + rowLength;
+   int fullRowWraps = width / size.width();
+   int partialRow = width % size.width();
+
    int y = offsety - size.height();
    while (y < size.height()) {
       if (y + height > 0) {
+         memset(columnSums, 0, rowLength * sizeof(quint64));
+         int currY = ((y % size.height()) + size.height()) % size.height();
+         for (int i = 0; i < height; i++) {
+            const unsigned char* srcRow = src + currY * rowLength;
+            for (int l = 0; l < rowLength; l++) {
+               columnSums[l] += srcRow[l];
+            }
+            if (++currY == size.height()) {
+               currY = 0;
+            }
+         }
+         memset(prefixSums, 0, 4 * sizeof(quint64));
+         for (int l = 0; l < rowLength; l++) {
+            prefixSums[l + 4] = prefixSums[l] + columnSums[l];
+         }
+         int stopY = qMin(y + height, size.height());
          int x = offsetx - size.width();
          while (x < size.width()) {
             if (x + width > 0) {
-               int totalPixels = 0;
-               quint64 red = 0;
-               quint64 green = 0;
-               quint64 blue = 0;
-               quint64 alpha = 0;
-               for (int ypos = y; ypos < y + height; ypos++) {
-                  int currY = ypos;
-                  if (currY < 0) {
-                     currY += size.height() * 5;
-                  }
-                  currY %= size.height();
-                  currY *= size.width();
-                  for (int xpos = x; xpos < x + width; xpos++) {
-                     int currX = xpos;
-                     if (currX < 0) {
-                        currX += size.width() * 5;
-                     }
-                     currX %= size.width();
-                     TexturePixel sourcePixel = sourceImage[currY + currX];
-                     totalPixels++;
-                     red += sourcePixel.r;
-                     green += sourcePixel.g;
-                     blue += sourcePixel.b;
-                     alpha += sourcePixel.a;
+               int start = (((x % size.width()) + size.width()) % size.width()) * 4;
+               int end = start + partialRow * 4;
+               quint64 sum[4];
+               for (int c = 0; c < 4; c++) {
+                  sum[c] = fullRowWraps * rowTotal[c];
+                  if (end <= rowLength) {
+                     sum[c] += prefixSums[end + c] - prefixSums[start + c];
+                  } else {
+                     sum[c] += rowTotal[c] - prefixSums[start + c] + prefixSums[end - rowLength + c];
                   }
                }
-               if (totalPixels > 0) {
-                  TexturePixel color(red / totalPixels, green / totalPixels,
-                                     blue / totalPixels, alpha / totalPixels);
-                  int stopY = qMin(y + height, size.height());
-                  for (int ypos = qMax(y, 0); ypos < stopY; ypos++) {
-                     int linestart = ypos * size.width();
-                     int stopX = qMin(x + width, size.width());
-                     for (int xpos = qMax(x, 0); xpos < stopX; xpos++) {
-                        destimage[linestart + xpos] = color;
-                     }
+               TexturePixel color(sum[2] / totalPixels, sum[1] / totalPixels,
+                                  sum[0] / totalPixels, sum[3] / totalPixels);
+               int stopX = qMin(x + width, size.width());
+               for (int ypos = qMax(y, 0); ypos < stopY; ypos++) {
+                  int linestart = ypos * size.width();
+                  for (int xpos = qMax(x, 0); xpos < stopX; xpos++) {
+                     destimage[linestart + xpos] = color;
                   }
                }
             }
@@ -112,4 +123,6 @@ void PixelateTextureGenerator::generate(QSize size,
       }
       y += height;
    }
+   delete[] columnSums;
+   delete[] prefixSums;
 }
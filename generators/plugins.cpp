@@ -0,0 +1,121 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#include "base/settingsmanager.h"
+#include "base/textureproject.h"
+#include "plugins.h"
+#include "texturegeneratorplugin.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QJsonObject>
+#include <QLibrary>
+#include <QPluginLoader>
+
+/**
+ * @brief PluginTexGenManager::PluginTexGenManager
+ * @param project
+ */
+PluginTexGenManager::PluginTexGenManager(TextureProject* project)
+{
+   this->project = project;
+   directoryPath = "";
+   enabled = false;
+   hasScannedDirectory = false;
+   QObject::connect(project->getSettingsManager(), &SettingsManager::settingsUpdated,
+                    this, &PluginTexGenManager::settingsUpdated);
+   QObject::connect(this, &PluginTexGenManager::generatorAdded,
+                    project, &TextureProject::addGenerator);
+   settingsUpdated();
+}
+
+/**
+ * @brief PluginTexGenManager::setEnabled
+ * @param enabled
+ * Sets whether it should load plugins from the selected directory.
+ */
+void PluginTexGenManager::setEnabled(bool enabled)
+{
+   this->enabled = enabled;
+   if (enabled && !hasScannedDirectory) {
+      setDirectory(directoryPath, true);
+   }
+}
+
+/**
+ * @brief PluginTexGenManager::settingsUpdated
+ * Updates the settings for the path and if the module's enabled.
+ */
+void PluginTexGenManager::settingsUpdated()
+{
+   setEnabled(project->getSettingsManager()->getPluginGeneratorsEnabled());
+   setDirectory(project->getSettingsManager()->getPluginGeneratorsPath());
+}
+
+/**
+ * @brief PluginTexGenManager::setDirectory
+ * @param path Absolute path to scan.
+ * @param forceScan True to force directory scan.
+ */
+void PluginTexGenManager::setDirectory(const QString& path, bool forceScan)
+{
+   if (!forceScan && directoryPath == path) {
+      return;
+   }
+   hasScannedDirectory = false;
+   directoryPath = path;
+   if (enabled) {
+      scanDirectory(path);
+      hasScannedDirectory = true;
+   }
+}
+
+/**
+ * @brief PluginTexGenManager::scanDirectory
+ * @param path Directory to search recursively.
+ *
+ * Loads all shared libraries in the directory and its sub-directories that
+ * implement TextureGeneratorPlugin, and emits their generators. Plugins
+ * stay loaded for the rest of the session, since nodes may still be
+ * using their generators. The generators' cache keys include the library's
+ * file name, modification time and the version in the plugin's metadata.
+ */
+void PluginTexGenManager::scanDirectory(const QString& path)
+{
+   QDir dir(path);
+   if (path.isEmpty() || !dir.exists()) {
+      return;
+   }
+   QDirIterator iterator(path, QDir::Files, QDirIterator::Subdirectories);
+   while (iterator.hasNext()) {
+      iterator.next();
+      QString filename = iterator.fileInfo().absoluteFilePath();
+      if (!QLibrary::isLibrary(filename) || loadedFiles.contains(filename)) {
+         continue;
+      }
+      QPluginLoader loader(filename);
+      if (loader.metaData().value("IID").toString() != TextureGeneratorPlugin_iid) {
+         continue;
+      }
+      auto* plugin = qobject_cast<TextureGeneratorPlugin*>(loader.instance());
+      if (!plugin) {
+         qDebug() << "Error loading plugin " << filename << ": " << loader.errorString();
+         continue;
+      }
+      loadedFiles.insert(filename);
+      QByteArray pluginKey;
+      QDataStream keyStream(&pluginKey, QIODevice::WriteOnly);
+      keyStream << iterator.fileName()
+                << iterator.fileInfo().lastModified().toMSecsSinceEpoch()
+                << loader.metaData().value("MetaData").toObject().value("version").toVariant().toString();
+      for (const TextureGeneratorPtr& generator : plugin->createGenerators()) {
+         emit generatorAdded(TextureGeneratorPtr(new PluginTexGen(generator, pluginKey)));
+      }
+   }
+}
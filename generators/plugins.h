@@ -0,0 +1,79 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef PLUGINTEXGENMANAGER_H
+#define PLUGINTEXGENMANAGER_H
+
+#include "texturegenerator.h"
+#include <QObject>
+#include <QSet>
+#include <utility>
+
+class TextureProject;
+
+/**
+ * @brief The PluginTexGenManager class
+ *
+ * Loads native TextureGenerator plugins from the selected directory.
+ */
+class PluginTexGenManager : public QObject
+{
+   Q_OBJECT
+
+public:
+   explicit PluginTexGenManager(TextureProject* project);
+   ~PluginTexGenManager() override = default;
+
+public slots:
+   void setDirectory(const QString& path, bool forceScan=false);
+   void setEnabled(bool);
+   void settingsUpdated();
+
+signals:
+   void generatorAdded(TextureGeneratorPtr);
+
+private:
+   void scanDirectory(const QString& path);
+
+   QString directoryPath;
+   QSet<QString> loadedFiles;
+   TextureProject* project;
+   bool enabled;
+   bool hasScannedDirectory;
+};
+
+/**
+ * @brief The PluginTexGen class
+ *
+ * Wraps a generator created by a plugin and adds the plugin's identity
+ * to its cache key, so that images rendered by another build of the
+ * plugin aren't reused.
+ */
+class PluginTexGen : public TextureGenerator
+{
+public:
+   PluginTexGen(TextureGeneratorPtr generator, QByteArray pluginKey)
+      : generator(std::move(generator)), pluginKey(std::move(pluginKey)) {}
+   void generate(QSize size, TexturePixel* destimage,
+                 QMap<int, TextureImagePtr> sourceimages,
+                 TextureNodeSettings* settings) const override {
+      generator->generate(size, destimage, sourceimages, settings);
+   }
+   const TextureGeneratorSettings& getSettings() const override { return generator->getSettings(); }
+   Type getType() const override { return generator->getType(); }
+   int getNumSourceSlots() const override { return generator->getNumSourceSlots(); }
+   QString getName() const override { return generator->getName(); }
+   QString getSlotName(int id) override { return generator->getSlotName(id); }
+   QString getDescription() const override { return generator->getDescription(); }
+   QByteArray getCacheKey() const override { return pluginKey + generator->getCacheKey(); }
+
+private:
+   TextureGeneratorPtr generator;
+   QByteArray pluginKey;
+};
+
+#endif // PLUGINTEXGENMANAGER_H
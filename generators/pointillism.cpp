@@ -6,14 +6,19 @@
  */
 
 
+#include "base/counterrandom.h"
+#include "base/parallelbands.h"
+#include "base/shaperasterizer.h"
 #include "pointillism.h"
-#include <QPainter>
+#include <QVector>
 #include <QtMath>
-#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
-#include <QRandomGenerator>
-#endif
 #include <cmath>
 
+/**
+ * Width and height of the screen tiles the points are binned into.
+ */
+static const int tileSize = 64;
+
 PointillismTextureGenerator::PointillismTextureGenerator()
 {
    TextureGeneratorSetting points;
@@ -74,7 +79,7 @@ void PointillismTextureGenerator::generate(QSize size,
    }
    double shapeWidth = settings->value("width").toDouble() * size.width() / 100;
    double shapeHeight = settings->value("height").toDouble() * size.height() / 100;
-   int randseed = settings->value("randseed").toInt();
+   quint32 randseed = settings->value("randseed").toUInt();
    int points = settings->value("points").toInt();
    bool includesource = settings->value("includesource").toBool();
    bool antialiasing = settings->value("antialiasing").toBool();
@@ -84,12 +89,6 @@ void PointillismTextureGenerator::generate(QSize size,
       return;
    }
 
-#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
-   srand(randseed);
-#else
-   QRandomGenerator random(randseed);
-#endif
-
    TexturePixel* sourceImage = sourceimages.value(0)->getData();
    if (includesource) {
       memcpy(destimage, sourceimages.value(0)->getData(), size.width() * size.height() * sizeof(TexturePixel));
@@ -97,26 +96,82 @@ void PointillismTextureGenerator::generate(QSize size,
       memset(destimage, 0, size.width() * size.height() * sizeof(TexturePixel));
    }
 
-   QImage tempimage = QImage(size.width(), size.height(), QImage::Format_RGB32);
-   memcpy(tempimage.bits(), destimage, size.width() * size.height() * sizeof(TexturePixel));
-
-   QPainter painter(&tempimage);
-   painter.setPen(Qt::NoPen);
-   painter.setRenderHint(QPainter::Antialiasing, antialiasing);
-   painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+   if (points <= 0 || shapeWidth <= 0 || shapeHeight <= 0) {
+      return;
+   }
 
+   // The points are drawn as ellipses with radii (shapeWidth, shapeHeight),
+   // centered on the corner of their source pixel like QPainter would.
+   int width = size.width();
+   int height = size.height();
+   QVector<QPoint> centers(points);
+   ParallelBands::run(points, [&](int start, int end) {
+      for (int i = start; i < end; i++) {
+         centers[i] = QPoint(CounterRandom::bounded(0, width, randseed, i, 0, 0),
+                             CounterRandom::bounded(0, height, randseed, i, 0, 1));
+      }
+   }, 1024);
+
+   // Bin the points into the tiles their bounding boxes overlap. Since the
+   // points are added in order, every tile's list is in drawing order.
+   int tilesX = (width + tileSize - 1) / tileSize;
+   int tilesY = (height + tileSize - 1) / tileSize;
+   QVector<QVector<int>> tiles(tilesX * tilesY);
    for (int i = 0; i < points; i++) {
-#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
-      int x = qrand() % size.width();
-      int y = qrand() % size.height();
-#else
-      int x = random.bounded(0, size.width());
-      int y = random.bounded(0, size.height());
-#endif
-      TexturePixel sourcePixel = sourceImage[y * size.width() + x];
-      QColor sourceColor(sourcePixel.r, sourcePixel.g, sourcePixel.b, sourcePixel.a);
-      painter.setBrush(QBrush(sourceColor, Qt::BrushStyle::SolidPattern));
-      painter.drawEllipse(QPointF(x, y), shapeWidth, shapeHeight);
+      const QPoint& center = centers.at(i);
+      int firstTileX = qMax(0, static_cast<int>(std::floor(center.x() - 0.5 - shapeWidth - 1)) / tileSize);
+      int lastTileX = qMin(tilesX - 1, static_cast<int>(std::ceil(center.x() - 0.5 + shapeWidth + 1)) / tileSize);
+      int firstTileY = qMax(0, static_cast<int>(std::floor(center.y() - 0.5 - shapeHeight - 1)) / tileSize);
+      int lastTileY = qMin(tilesY - 1, static_cast<int>(std::ceil(center.y() - 0.5 + shapeHeight + 1)) / tileSize);
+      for (int tileY = firstTileY; tileY <= lastTileY; tileY++) {
+         for (int tileX = firstTileX; tileX <= lastTileX; tileX++) {
+            tiles[tileY * tilesX + tileX].append(i);
+         }
+      }
    }
-   memcpy(destimage, tempimage.bits(), size.width() * size.height() * sizeof(TexturePixel));
+
+   // Each tile is drawn by one thread. The pixels of a tile are only
+   // touched by that thread and in the points' order, so the result is
+   // the same as drawing all points one after the other.
+   float radiusX = shapeWidth;
+   float radiusY = shapeHeight;
+   ParallelBands::run(tiles.size(), [&](int startTile, int endTile) {
+      for (int tile = startTile; tile < endTile; tile++) {
+         QRect tileRect(QPoint((tile % tilesX) * tileSize, (tile / tilesX) * tileSize),
+                        QSize(tileSize, tileSize));
+         tileRect &= QRect(0, 0, width, height);
+         for (int i : tiles.at(tile)) {
+            const QPoint& center = centers.at(i);
+            const TexturePixel& color = sourceImage[center.y() * width + center.x()];
+            if (color.a == 0) {
+               continue;
+            }
+            float colorAlpha = color.a / 255.0f;
+            float centerX = center.x() - 0.5f;
+            float centerY = center.y() - 0.5f;
+            int startX = qMax(tileRect.left(), static_cast<int>(std::floor(centerX - radiusX - 1)));
+            int endX = qMin(tileRect.right(), static_cast<int>(std::ceil(centerX + radiusX + 1)));
+            int startY = qMax(tileRect.top(), static_cast<int>(std::floor(centerY - radiusY - 1)));
+            int endY = qMin(tileRect.bottom(), static_cast<int>(std::ceil(centerY + radiusY + 1)));
+            for (int y = startY; y <= endY; y++) {
+               float dy = (y - centerY) / radiusY;
+               TexturePixel* destRow = destimage + y * width;
+               for (int x = startX; x <= endX; x++) {
+                  float dx = (x - centerX) / radiusX;
+                  // Approximate the distance to the ellipse's edge from
+                  // its implicit function and that function's gradient.
+                  float implicit = dx * dx + dy * dy - 1;
+                  float gradientX = dx / radiusX;
+                  float gradientY = dy / radiusY;
+                  float gradientLength = 2 * std::sqrt(gradientX * gradientX + gradientY * gradientY);
+                  float distance = gradientLength > 0 ? implicit / gradientLength : -1;
+                  float coverage = ShapeRasterizer::edgeCoverage(distance, antialiasing);
+                  if (coverage > 0) {
+                     ShapeRasterizer::compositeOver(destRow[x], color, coverage * colorAlpha);
+                  }
+               }
+            }
+         }
+      }
+   }, 1);
 }
@@ -5,12 +5,9 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
-#include "blending.h"
-#include "fill.h"
-#include "setchannels.h"
+#include "base/parallelbands.h"
 #include "shadow.h"
 #include "stackblur.h"
-#include "transform.h"
 #include <QColor>
 #include <QMap>
 #include <cmath>
@@ -65,6 +62,13 @@ ShadowTextureGenerator::ShadowTextureGenerator()
 }
 
 
+/**
+ * @brief ShadowTextureGenerator::generate
+ *
+ * Only the source's alpha channel is blurred, as a single channel buffer.
+ * The offset and scale are applied when sampling the blurred alpha in the
+ * loop that composites the source on top of the shadow.
+ */
 void ShadowTextureGenerator::generate(QSize size,
                                       TexturePixel* destimage,
                                       QMap<int, TextureImagePtr> sourceimages,
@@ -77,62 +81,70 @@ void ShadowTextureGenerator::generate(QSize size,
       memset(destimage, 0, size.width() * size.height() * sizeof(TexturePixel));
       return;
    }
-   FillTextureGenerator fillgen;
-   auto* filledImage = new TexturePixel[size.width() * size.height()];
-   TextureImagePtr filledImagePtr(new TextureImage(size, filledImage));
-   fillgen.generate(size, filledImage, sourceimages, settings);
-
-   SetChannelsTextureGenerator setchannelsgen;
-   QMap<int, TextureImagePtr> setchannelImages;
-   setchannelImages.insert(0, filledImagePtr);
-   setchannelImages.insert(1, sourceimages.value(0));
-   TextureNodeSettings settingsForSetchannels;
-   settingsForSetchannels.insert("channelRed", QVariant("First's red"));
-   settingsForSetchannels.insert("channelGreen", QVariant("First's green"));
-   settingsForSetchannels.insert("channelBlue", QVariant("First's blue"));
-   settingsForSetchannels.insert("channelAlpha", QVariant("Second's alpha"));
-   auto* setchannelsImage = new TexturePixel[size.width() * size.height()];
-   TextureImagePtr setchannelsImagePtr(new TextureImage(size, setchannelsImage));
-   setchannelsgen.generate(size, setchannelsImage, setchannelImages, &settingsForSetchannels);
+   int width = size.width();
+   int height = size.height();
+   int numPixels = width * height;
+   TexturePixel* sourceImage = sourceimages.value(0)->getData();
+   QColor color = settings->value("color").value<QColor>();
+   double scaleX = settings->value("xscale").toDouble() / 100;
+   double scaleY = settings->value("yscale").toDouble() / 100;
+   int offsetLeft = settings->value("offsetleft").toDouble() * width / 100;
+   int offsetTop = settings->value("offsettop").toDouble() * height / 100;
+   int level = settings->value("level").toInt() * qMax(width / 100, 1);
 
-   StackBlurTextureGenerator stackblurgen;
-   QMap<int, TextureImagePtr> blurSettingsIterator;
-   blurSettingsIterator.insert(0, setchannelsImagePtr);
-   TextureNodeSettings settingsForBlur;
-   settingsForBlur.insert("level", QVariant(settings->value("level").toInt()));
-   auto* blurredImage = new TexturePixel[size.width() * size.height()];
-   TextureImagePtr blurredImagePtr(new TextureImage(size, blurredImage));
-   stackblurgen.generate(size, blurredImage, blurSettingsIterator, &settingsForBlur);
-
-   TransformTextureGenerator transformgen;
-   QMap<int, TextureImagePtr> sourceForTransform;
-   sourceForTransform.insert(0, blurredImagePtr);
-   TextureNodeSettings settingsForTransform;
-   QMapIterator<QString, TextureGeneratorSetting> transformSettingsIterator(transformgen.getSettings());
-   while (transformSettingsIterator.hasNext()) {
-      transformSettingsIterator.next();
-      settingsForTransform.insert(transformSettingsIterator.key(), transformSettingsIterator.value().defaultvalue);
+   auto* shadowAlpha = new unsigned char[numPixels];
+   for (int i = 0; i < numPixels; i++) {
+      shadowAlpha[i] = sourceImage[i].a;
+   }
+   if (level > 0) {
+      StackBlurTextureGenerator stackblurgen;
+      stackblurgen.blurPlane(size, shadowAlpha, level);
    }
-   settingsForTransform.insert("offsetleft", QVariant(settings->value("offsetleft").toDouble()));
-   settingsForTransform.insert("offsettop", QVariant(settings->value("offsettop").toDouble()));
-   settingsForTransform.insert("xscale", QVariant(settings->value("xscale").toDouble()));
-   settingsForTransform.insert("yscale", QVariant(settings->value("yscale").toDouble()));
-   auto* transformedImage = new TexturePixel[size.width() * size.height()];
-   TextureImagePtr transformedImagePtr(new TextureImage(size, transformedImage));
-   transformgen.generate(size, transformedImage, sourceForTransform, &settingsForTransform);
 
-   BlendingTextureGenerator blendinggen;
-   QMap<int, TextureImagePtr> sourceForBlend;
-   sourceForBlend.insert(0, transformedImagePtr);
-   sourceForBlend.insert(1, sourceimages.value(0));
-   TextureNodeSettings settingsForBlend;
-   QMapIterator<QString, TextureGeneratorSetting> blendSettingsIterator(blendinggen.getSettings());
-   while (blendSettingsIterator.hasNext()) {
-      blendSettingsIterator.next();
-      settingsForBlend.insert(blendSettingsIterator.key(), blendSettingsIterator.value().defaultvalue);
+   // The shadow is scaled around the center. Like the transformed copy
+   // the shadow used to be drawn from, it's transparent where it samples
+   // outside the source, marked by a column of -1 or a null row.
+   bool visible = scaleX > 0 && scaleY > 0;
+   auto* shadowColumns = new int[width];
+   for (int x = 0; visible && x < width; x++) {
+      double srcX = std::floor((x + 0.5 - offsetLeft - width / 2) / scaleX + width / 2);
+      shadowColumns[x] = (srcX >= 0 && srcX < width) ? static_cast<int>(srcX) : -1;
    }
-   auto* blendedImage = new TexturePixel[size.width() * size.height()];
-   blendinggen.generate(size, blendedImage, sourceForBlend, &settingsForBlend);
-   memcpy(destimage, blendedImage, size.width() * size.height() * sizeof(TexturePixel));
-   delete[] blendedImage;
+   float shadowR = color.red();
+   float shadowG = color.green();
+   float shadowB = color.blue();
+
+   ParallelBands::run(height, [=](int startY, int endY) {
+      for (int y = startY; y < endY; y++) {
+         const unsigned char* shadowRow = nullptr;
+         if (visible) {
+            double srcY = std::floor((y + 0.5 - offsetTop - height / 2) / scaleY + height / 2);
+            if (srcY >= 0 && srcY < height) {
+               shadowRow = shadowAlpha + static_cast<int>(srcY) * width;
+            }
+         }
+         for (int x = 0; x < width; x++) {
+            int thisPos = y * width + x;
+            const TexturePixel& source = sourceImage[thisPos];
+            float sourceAlpha = source.a / 255.0f;
+            float shadowAlphaValue = 0;
+            if (shadowRow && shadowColumns[x] >= 0) {
+               shadowAlphaValue = shadowRow[shadowColumns[x]] / 255.0f;
+            }
+            float pixelAlpha = sourceAlpha + shadowAlphaValue - sourceAlpha * shadowAlphaValue;
+            if (pixelAlpha <= 0) {
+               destimage[thisPos] = TexturePixel(0, 0, 0, 0);
+               continue;
+            }
+            float sourceFraction = sourceAlpha / pixelAlpha;
+            float shadowFraction = 1 - sourceFraction;
+            destimage[thisPos].r = static_cast<unsigned char>(shadowFraction * shadowR + sourceFraction * source.r + 0.5f);
+            destimage[thisPos].g = static_cast<unsigned char>(shadowFraction * shadowG + sourceFraction * source.g + 0.5f);
+            destimage[thisPos].b = static_cast<unsigned char>(shadowFraction * shadowB + sourceFraction * source.b + 0.5f);
+            destimage[thisPos].a = static_cast<unsigned char>(pixelAlpha * 255 + 0.5f);
+         }
+      }
+   });
+   delete[] shadowColumns;
+   delete[] shadowAlpha;
 }
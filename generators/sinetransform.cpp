@@ -5,6 +5,7 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/warpsampler.h"
 #include "sinetransform.h"
 #include <QtMath>
 #include <cmath>
@@ -66,6 +67,8 @@ SineTransformTextureGenerator::SineTransformTextureGenerator()
    offsettwo.max = QVariant(360);
    offsettwo.order = 7;
    configurables.insert("offsettwo", offsettwo);
+
+   WarpSampler::addSettings(configurables, 8);
 }
 
 
@@ -93,42 +96,26 @@ void SineTransformTextureGenerator::generate(QSize size,
    TexturePixel* source = sourceimages.value(0)->getData();
    angle = (angle / 180.0) * ((double) M_PI);
 
-   double x1 = 0;
-   double y1 = -10000;
-   double x1rot = (x1 * cos(angle)) - (y1 * sin(angle));
-   double y1rot = (y1 * cos(angle)) + (x1 * sin(angle));
-   x1 = x1rot;
-   y1 = y1rot;
-   double x2 = -x1;
-   double y2 = -y1;
+   // The waves run perpendicular to a line through the origin at the given
+   // angle, so the distance to that line is x * cos(angle) + y * sin(angle).
+   // The pixels are moved along the line's direction.
+   float cosAngle = cos(angle);
+   float sinAngle = sin(angle);
+   float freqOne = frequencyone;
+   float ampOne = amplitudeone;
+   float offOne = offsetone;
+   float freqTwo = frequencytwo;
+   float ampTwo = amplitudetwo;
+   float offTwo = offsettwo;
 
-   for (int y = 0; y < size.height(); y++) {
-      for (int x = 0; x < size.width(); x++) {
-         double x4 = -10000;
-         double y4 = y;
-         double x4rot = ((x4 - x) * cos(angle)) - ((y4 - y) * sin(angle)) + x;
-         double y4rot = ((y4 - y) * cos(angle)) + ((x4 - x) * sin(angle)) + y;
-         x4 = x4rot;
-         y4 = y4rot;
-         double intersection_x = ((x2 * y1 - x1 * y2) * (x4 - x) - (x4 * y - x * y4) * (x2 - x1)) /
-               ((x2 - x1) * (y4 - y) - (x4 - x) * (y2 - y1));
-         double intersection_y = ((x2 * y1 - x1 * y2) * (y4 - y) - (x4 * y - x * y4) * (y2 - y1)) /
-               ((x2 - x1) * (y4 - y) - (x4 - x) * (y2 - y1));
-         double distance = sqrt((x - intersection_x) * (x - intersection_x) + (y - intersection_y) * (y - intersection_y));
-         double srcDistance =
-               sin(distance * frequencyone + offsetone) * amplitudeone +
-               sin(distance * frequencytwo + offsettwo) * amplitudetwo;
-         x4 = x;
-         y4 = y - srcDistance;
-         int xpos = ((x4 - x) * cos(angle)) - ((y4 - y) * sin(angle)) + x;
-         int ypos = ((y4 - y) * cos(angle)) + ((x4 - x) * sin(angle)) + y;
-         xpos = xpos > size.height() ? xpos % size.height() :
-                                       (xpos < 0 ? xpos + size.width() : xpos);
-         ypos = ypos > size.height() ? ypos % size.height() :
-                                       (ypos < 0 ? ypos + size.height() : ypos);
-         xpos = qMax(qMin(xpos, size.width() - 1), 0);
-         ypos = qMax(qMin(ypos, size.height() - 1), 0);
-         destimage[y * size.width() + x] = source[ypos * size.width() + xpos];
+   WarpSampler::warp(size, destimage, source, [=](int y, int width, float* sourceX, float* sourceY) {
+      float rowDistance = y * sinAngle;
+      for (int x = 0; x < width; x++) {
+         float distance = std::fabs(x * cosAngle + rowDistance);
+         float srcDistance = std::sin(distance * freqOne + offOne) * ampOne +
+                             std::sin(distance * freqTwo + offTwo) * ampTwo;
+         sourceX[x] = x + srcDistance * sinAngle;
+         sourceY[x] = y - srcDistance * cosAngle;
       }
-   }
+   }, WarpSampler::getEdges(settings), WarpSampler::getFilter(settings));
 }
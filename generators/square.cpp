@@ -6,8 +6,9 @@
  */
 
 
+#include "base/shaperasterizer.h"
 #include "square.h"
-#include <QPainter>
+#include <QtMath>
 #include <cmath>
 
 SquareTextureGenerator::SquareTextureGenerator()
@@ -108,8 +109,8 @@ void SquareTextureGenerator::generate(QSize size,
    double rotation = settings->value("rotation").toDouble();
    int offsetLeft = settings->value("offsetleft").toDouble() * size.width() / 100;
    int offsetTop = settings->value("offsettop").toDouble() * size.height() / 100;
-   double cutoutInnerRadius = settings->value("cutoutwidth").toDouble() / 100;
-   double cutoutOuterRadius = settings->value("cutoutheight").toDouble() / 100;
+   double cutoutWidth = settings->value("cutoutwidth").toDouble() / 100;
+   double cutoutHeight = settings->value("cutoutheight").toDouble() / 100;
    bool antialiasing = settings->value("antialiasing").toBool();
 
    if (sourceimages.contains(0)) {
@@ -118,44 +119,35 @@ void SquareTextureGenerator::generate(QSize size,
       memset(destimage, 0, size.width() * size.height() * sizeof(TexturePixel));
    }
 
-   QImage tempimage = QImage(size.width(), size.height(), QImage::Format_RGB32);
-   memcpy(tempimage.bits(), destimage, size.width() * size.height() * sizeof(TexturePixel));
-
-   offsetLeft += (double) 50 * size.width() / 100;
-   offsetTop += (double) 50 * size.height() / 100;
-
-   QPainter painter(&tempimage);
-   painter.translate(offsetLeft, offsetTop);
-   painter.rotate(rotation);
-   painter.translate(-shapeWidth / 2, -shapeHeight / 2);
-   painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-   painter.setBrush(QBrush(color, Qt::BrushStyle::SolidPattern));
-   QPainterPath path;
-
-   QPolygonF squarePolygon;
-   squarePolygon << QPointF(0, 0);
-   squarePolygon << QPointF(0, 1);
-   squarePolygon << QPointF(1, 1);
-   squarePolygon << QPointF(1, 0);
-   path.addPolygon(squarePolygon);
-
-   cutoutInnerRadius /= 2;
-   cutoutOuterRadius /= 2;
-
-   QPolygonF removeSquarePolygon;
-   removeSquarePolygon << QPointF(0.5 - cutoutInnerRadius, 0.5 - cutoutOuterRadius);
-   removeSquarePolygon << QPointF(0.5 - cutoutInnerRadius, 0.5 + cutoutOuterRadius);
-   removeSquarePolygon << QPointF(0.5 + cutoutInnerRadius, 0.5 + cutoutOuterRadius);
-   removeSquarePolygon << QPointF(0.5 + cutoutInnerRadius, 0.5 - cutoutOuterRadius);
-
-   QPainterPath removepath;
-   removepath.addPolygon(removeSquarePolygon);
-   path = path.subtracted(removepath);
-
-   painter.scale(shapeWidth, shapeHeight);
-   painter.setRenderHint(QPainter::Antialiasing, antialiasing);
-   painter.setPen(Qt::NoPen);
-   painter.drawPath(path);
-
-   memcpy(destimage, tempimage.bits(), size.width() * size.height() * sizeof(TexturePixel));
+   if (shapeWidth <= 0 || shapeHeight <= 0) {
+      return;
+   }
+   float centerX = offsetLeft + (double) 50 * size.width() / 100;
+   float centerY = offsetTop + (double) 50 * size.height() / 100;
+   float halfWidth = shapeWidth / 2;
+   float halfHeight = shapeHeight / 2;
+   float cutoutHalfWidth = cutoutWidth * halfWidth;
+   float cutoutHalfHeight = cutoutHeight * halfHeight;
+   bool cutout = cutoutHalfWidth > 0 && cutoutHalfHeight > 0;
+   double angle = (rotation / 180.0) * ((double) M_PI);
+   float cosAngle = cos(angle);
+   float sinAngle = sin(angle);
+
+   ShapeRasterizer::fill(size, QRect(QPoint(0, 0), size), destimage, color,
+                         [=](int y, int startX, int count, float* coverage) {
+      float dy = y + 0.5f - centerY;
+      for (int i = 0; i < count; i++) {
+         // Rotate the pixel's center back into the square's coordinates.
+         float dx = startX + i + 0.5f - centerX;
+         float localX = dx * cosAngle + dy * sinAngle;
+         float localY = dy * cosAngle - dx * sinAngle;
+         float shape = ShapeRasterizer::edgeCoverage(
+                  ShapeRasterizer::boxDistance(localX, localY, halfWidth, halfHeight), antialiasing);
+         if (cutout && shape > 0) {
+            shape *= 1 - ShapeRasterizer::edgeCoverage(
+                     ShapeRasterizer::boxDistance(localX, localY, cutoutHalfWidth, cutoutHalfHeight), antialiasing);
+         }
+         coverage[i] = shape;
+      }
+   });
 }
@@ -5,8 +5,56 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/parallelbands.h"
 #include "stackblur.h"
 
+// The Stack Blur Algorithm was invented by Mario Klingemann,
+// mario@quasimondo.com and described here:
+// http://incubator.quasimondo.com/processing/fast_blur_deluxe.php
+// This version is based on a version written by
+// Victor Laskin (victor.laskin@gmail.com)
+// http://vitiy.info/stackblur-algorithm-multi-threaded-blur-for-cpp
+
+static const quint16 stackblur_mul[255] =
+{
+   512, 512, 456, 512, 328, 456, 335, 512, 405, 328, 271, 456, 388, 335, 292, 512,
+   454, 405, 364, 328, 298, 271, 496, 456, 420, 388, 360, 335, 312, 292, 273, 512,
+   482, 454, 428, 405, 383, 364, 345, 328, 312, 298, 284, 271, 259, 496, 475, 456,
+   437, 420, 404, 388, 374, 360, 347, 335, 323, 312, 302, 292, 282, 273, 265, 512,
+   497, 482, 468, 454, 441, 428, 417, 405, 394, 383, 373, 364, 354, 345, 337, 328,
+   320, 312, 305, 298, 291, 284, 278, 271, 265, 259, 507, 496, 485, 475, 465, 456,
+   446, 437, 428, 420, 412, 404, 396, 388, 381, 374, 367, 360, 354, 347, 341, 335,
+   329, 323, 318, 312, 307, 302, 297, 292, 287, 282, 278, 273, 269, 265, 261, 512,
+   505, 497, 489, 482, 475, 468, 461, 454, 447, 441, 435, 428, 422, 417, 411, 405,
+   399, 394, 389, 383, 378, 373, 368, 364, 359, 354, 350, 345, 341, 337, 332, 328,
+   324, 320, 316, 312, 309, 305, 301, 298, 294, 291, 287, 284, 281, 278, 274, 271,
+   268, 265, 262, 259, 257, 507, 501, 496, 491, 485, 480, 475, 470, 465, 460, 456,
+   451, 446, 442, 437, 433, 428, 424, 420, 416, 412, 408, 404, 400, 396, 392, 388,
+   385, 381, 377, 374, 370, 367, 363, 360, 357, 354, 350, 347, 344, 341, 338, 335,
+   332, 329, 326, 323, 320, 318, 315, 312, 310, 307, 304, 302, 299, 297, 294, 292,
+   289, 287, 285, 282, 280, 278, 275, 273, 271, 269, 267, 265, 263, 261, 259
+};
+
+static const quint8 stackblur_shr[255] =
+{
+   9,  11, 12, 13, 13, 14, 14, 15, 15, 15, 15, 16, 16, 16, 16, 17,
+   17, 17, 17, 17, 17, 17, 18, 18, 18, 18, 18, 18, 18, 18, 18, 19,
+   19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 20, 20, 20,
+   20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 21,
+   21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21,
+   21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 22, 22, 22, 22, 22, 22,
+   22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,
+   22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 23,
+   23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23,
+   23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23,
+   23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23,
+   23, 23, 23, 23, 23, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
+   24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
+   24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
+   24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
+   24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24
+};
+
 StackBlurTextureGenerator::StackBlurTextureGenerator()
 {
    TextureGeneratorSetting level;
@@ -33,68 +81,102 @@ void StackBlurTextureGenerator::generate(QSize size,
    }
    TexturePixel* sourceImage = sourceimages.value(0).data()->getData();
    memcpy(destimage, sourceImage, size.width() * size.height() * sizeof(TexturePixel));
-   if (level == 0) {
+   if (level <= 0) {
       return;
    }
+   blur(size, destimage, level);
+}
 
-   // The Stack Blur Algorithm was invented by Mario Klingemann,
-   // mario@quasimondo.com and described here:
-   // http://incubator.quasimondo.com/processing/fast_blur_deluxe.php
-   // This version is based on a version written by
-   // Victor Laskin (victor.laskin@gmail.com)
-   // http://vitiy.info/stackblur-algorithm-multi-threaded-blur-for-cpp
-
-   quint16 stackblur_mul[255] =
-   {
-      512, 512, 456, 512, 328, 456, 335, 512, 405, 328, 271, 456, 388, 335, 292, 512,
-      454, 405, 364, 328, 298, 271, 496, 456, 420, 388, 360, 335, 312, 292, 273, 512,
-      482, 454, 428, 405, 383, 364, 345, 328, 312, 298, 284, 271, 259, 496, 475, 456,
-      437, 420, 404, 388, 374, 360, 347, 335, 323, 312, 302, 292, 282, 273, 265, 512,
-      497, 482, 468, 454, 441, 428, 417, 405, 394, 383, 373, 364, 354, 345, 337, 328,
-      320, 312, 305, 298, 291, 284, 278, 271, 265, 259, 507, 496, 485, 475, 465, 456,
-      446, 437, 428, 420, 412, 404, 396, 388, 381, 374, 367, 360, 354, 347, 341, 335,
-      329, 323, 318, 312, 307, 302, 297, 292, 287, 282, 278, 273, 269, 265, 261, 512,
-      505, 497, 489, 482, 475, 468, 461, 454, 447, 441, 435, 428, 422, 417, 411, 405,
-      399, 394, 389, 383, 378, 373, 368, 364, 359, 354, 350, 345, 341, 337, 332, 328,
-      324, 320, 316, 312, 309, 305, 301, 298, 294, 291, 287, 284, 281, 278, 274, 271,
-      268, 265, 262, 259, 257, 507, 501, 496, 491, 485, 480, 475, 470, 465, 460, 456,
-      451, 446, 442, 437, 433, 428, 424, 420, 416, 412, 408, 404, 400, 396, 392, 388,
-      385, 381, 377, 374, 370, 367, 363, 360, 357, 354, 350, 347, 344, 341, 338, 335,
-      332, 329, 326, 323, 320, 318, 315, 312, 310, 307, 304, 302, 299, 297, 294, 292,
-      289, 287, 285, 282, 280, 278, 275, 273, 271, 269, 267, 265, 263, 261, 259
-   };
-
-   quint8 stackblur_shr[255] =
-   {
-      9,  11, 12, 13, 13, 14, 14, 15, 15, 15, 15, 16, 16, 16, 16, 17,
-      17, 17, 17, 17, 17, 17, 18, 18, 18, 18, 18, 18, 18, 18, 18, 19,
-      19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 19, 20, 20, 20,
-      20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 20, 21,
-      21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 21,
-      21, 21, 21, 21, 21, 21, 21, 21, 21, 21, 22, 22, 22, 22, 22, 22,
-      22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22,
-      22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 22, 23,
-      23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23,
-      23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23,
-      23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23, 23,
-      23, 23, 23, 23, 23, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
-      24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
-      24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
-      24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24,
-      24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24, 24
-   };
-
-   /// Stackblur algorithm body
-   unsigned int radius = level;
-   unsigned int div = (radius * 2) + 1;
-   auto* stack = new unsigned char [div * 4];
-   memset(stack, 0, div * 4);
-   auto* src = reinterpret_cast<unsigned char*>(destimage);
 
+/**
+ * @brief StackBlurTextureGenerator::blur
+ * @param size Image size
+ * @param image The image to be blurred in place
+ * @param radius Blur radius in pixels
+ *
+ * The horizontal pass is split into bands of rows and the vertical pass
+ * into bands of columns, each band with its own stack. All rows are done
+ * before the first column is started.
+ */
+void StackBlurTextureGenerator::blur(QSize size, TexturePixel* image, unsigned int radius) const
+{
+   auto* src = reinterpret_cast<unsigned char*>(image);
    unsigned int w = size.width();
    unsigned int h = size.height();
+   ParallelBands::run(h, [=](int minY, int maxY) {
+      blurRows(src, w, radius, minY, maxY);
+   });
+   ParallelBands::run(w, [=](int minX, int maxX) {
+      blurColumns(src, w, h, radius, minX, maxX);
+   });
+}
+
+
+/**
+ * @brief StackBlurTextureGenerator::blurPlane
+ * @param size Image size
+ * @param plane Single channel image, one byte per pixel, blurred in place
+ * @param radius Blur radius in pixels
+ *
+ * Same blur as blur(), for filters that only need to blur a mask.
+ */
+void StackBlurTextureGenerator::blurPlane(QSize size, unsigned char* plane, unsigned int radius) const
+{
+   unsigned int w = size.width();
+   unsigned int h = size.height();
+   ParallelBands::run(h, [=](int minY, int maxY) {
+      auto* stack = new unsigned char[radius * 2 + 1];
+      for (int y = minY; y < maxY; y++) {
+         blurPlaneLine(plane + y * w, 1, w, radius, stack);
+      }
+      delete[] stack;
+   });
+   ParallelBands::run(w, [=](int minX, int maxX) {
+      auto* stack = new unsigned char[radius * 2 + 1];
+      for (int x = minX; x < maxX; x++) {
+         blurPlaneLine(plane + x, w, h, radius, stack);
+      }
+      delete[] stack;
+   });
+}
+
 
-   unsigned int x, y, xp, yp, i;
+/**
+ * @brief StackBlurTextureGenerator::getMulShr
+ * @param radius Blur radius
+ * @param mul_sum Set to the multiplier
+ * @param shr_sum Set to the shift
+ *
+ * (sum * mul_sum) >> shr_sum divides a stack sum by (radius + 1)^2.
+ * The lookup tables cover radii up to 254. Larger radii, used when big
+ * images are blurred proportionally, get a multiplier with 40 bits of precision.
+ */
+void StackBlurTextureGenerator::getMulShr(unsigned int radius, quint64& mul_sum, unsigned char& shr_sum) const
+{
+   if (radius < 255) {
+      mul_sum = stackblur_mul[radius];
+      shr_sum = stackblur_shr[radius];
+      return;
+   }
+   quint64 divisor = static_cast<quint64>(radius + 1) * (radius + 1);
+   shr_sum = 40;
+   mul_sum = ((static_cast<quint64>(1) << shr_sum) + divisor - 1) / divisor;
+}
+
+
+/**
+ * @brief StackBlurTextureGenerator::blurRows
+ *
+ * Horizontal pass for the rows [minY, maxY).
+ */
+void StackBlurTextureGenerator::blurRows(unsigned char* src, unsigned int w, unsigned int radius,
+                                         unsigned int minY, unsigned int maxY) const
+{
+   unsigned int div = (radius * 2) + 1;
+   auto* stack = new unsigned char [div * 4];
+   memset(stack, 0, div * 4);
+
+   unsigned int x, y, xp, i;
    unsigned int sp;
    unsigned int stack_start;
    unsigned char* stack_ptr;
@@ -115,14 +197,12 @@ void StackBlurTextureGenerator::generate(QSize size,
    quint64 sum_out_b;
    quint64 sum_out_a;
 
+   quint64 mul_sum;
+   unsigned char shr_sum;
+   getMulShr(radius, mul_sum, shr_sum);
+
    unsigned int wm = w - 1;
-   unsigned int hm = h - 1;
    unsigned int w4 = w * 4;
-   unsigned int mul_sum = stackblur_mul[radius];
-   unsigned char shr_sum = stackblur_shr[radius];
-
-   unsigned int minY = 0;
-   unsigned int maxY = size.height();
 
    for (y = minY; y < maxY; y++) {
       sum_r = 0;
@@ -235,10 +315,49 @@ void StackBlurTextureGenerator::generate(QSize size,
          sum_in_a -= stack_ptr[3];
       }
    }
+   delete[] stack;
+}
+
+
+/**
+ * @brief StackBlurTextureGenerator::blurColumns
+ *
+ * Vertical pass for the columns [minX, maxX).
+ */
+void StackBlurTextureGenerator::blurColumns(unsigned char* src, unsigned int w, unsigned int h,
+                                            unsigned int radius, unsigned int minX, unsigned int maxX) const
+{
+   unsigned int div = (radius * 2) + 1;
+   auto* stack = new unsigned char [div * 4];
+   memset(stack, 0, div * 4);
 
-   // step 2
-   int minX = 0;
-   unsigned int maxX = size.width();
+   unsigned int x, y, yp, i;
+   unsigned int sp;
+   unsigned int stack_start;
+   unsigned char* stack_ptr;
+
+   unsigned char* src_ptr;
+   unsigned char* dst_ptr;
+
+   quint64 sum_r;
+   quint64 sum_g;
+   quint64 sum_b;
+   quint64 sum_a;
+   quint64 sum_in_r;
+   quint64 sum_in_g;
+   quint64 sum_in_b;
+   quint64 sum_in_a;
+   quint64 sum_out_r;
+   quint64 sum_out_g;
+   quint64 sum_out_b;
+   quint64 sum_out_a;
+
+   quint64 mul_sum;
+   unsigned char shr_sum;
+   getMulShr(radius, mul_sum, shr_sum);
+
+   unsigned int hm = h - 1;
+   unsigned int w4 = w * 4;
 
    for (x = minX; x < maxX; x++) {
       sum_r = 0;
@@ -354,3 +473,76 @@ void StackBlurTextureGenerator::generate(QSize size,
    }
    delete[] stack;
 }
+
+
+/**
+ * @brief StackBlurTextureGenerator::blurPlaneLine
+ * @param line First value of the line
+ * @param stride Distance between the line's values
+ * @param length Number of values in the line
+ * @param radius Blur radius
+ * @param stack Buffer for radius * 2 + 1 values
+ *
+ * Single channel version of the passes in blurRows() and blurColumns().
+ */
+void StackBlurTextureGenerator::blurPlaneLine(unsigned char* line, unsigned int stride, unsigned int length,
+                                              unsigned int radius, unsigned char* stack) const
+{
+   unsigned int div = (radius * 2) + 1;
+   unsigned int lm = length - 1;
+   unsigned int i, p, sp, stack_start;
+
+   quint64 mul_sum;
+   unsigned char shr_sum;
+   getMulShr(radius, mul_sum, shr_sum);
+
+   quint64 sum = 0;
+   quint64 sum_in = 0;
+   quint64 sum_out = 0;
+   unsigned char* src_ptr = line;
+   for (i = 0; i <= radius; i++) {
+      stack[i] = *src_ptr;
+      sum += *src_ptr * (i + 1);
+      sum_out += *src_ptr;
+   }
+   for (i = 1; i <= radius; i++) {
+      if (i <= lm) {
+         src_ptr += stride;
+      }
+      stack[i + radius] = *src_ptr;
+      sum += *src_ptr * (radius + 1 - i);
+      sum_in += *src_ptr;
+   }
+   sp = radius;
+   p = radius;
+   if (p > lm) {
+      p = lm;
+   }
+   src_ptr = line + p * stride;
+   unsigned char* dst_ptr = line;
+   for (i = 0; i < length; i++) {
+      *dst_ptr = (sum * mul_sum) >> shr_sum;
+      dst_ptr += stride;
+
+      sum -= sum_out;
+      stack_start = sp + div - radius;
+      if (stack_start >= div) {
+         stack_start -= div;
+      }
+      sum_out -= stack[stack_start];
+      if (p < lm) {
+         src_ptr += stride;
+         ++p;
+      }
+      stack[stack_start] = *src_ptr;
+      sum_in += *src_ptr;
+      sum += sum_in;
+
+      ++sp;
+      if (sp >= div) {
+         sp = 0;
+      }
+      sum_out += stack[sp];
+      sum_in -= stack[sp];
+   }
+}
@@ -28,7 +28,17 @@ public:
    QString getDescription() const override { return QString("Blurs the source image."); }
    TextureGenerator::Type getType() const override { return TextureGenerator::Type::Filter; }
 
+   void blur(QSize size, TexturePixel* image, unsigned int radius) const;
+   void blurPlane(QSize size, unsigned char* plane, unsigned int radius) const;
+
 private:
+   void getMulShr(unsigned int radius, quint64& mul_sum, unsigned char& shr_sum) const;
+   void blurRows(unsigned char* src, unsigned int w, unsigned int radius,
+                 unsigned int minY, unsigned int maxY) const;
+   void blurColumns(unsigned char* src, unsigned int w, unsigned int h, unsigned int radius,
+                    unsigned int minX, unsigned int maxX) const;
+   void blurPlaneLine(unsigned char* line, unsigned int stride, unsigned int length,
+                      unsigned int radius, unsigned char* stack) const;
    TextureGeneratorSettings configurables;
 };
 
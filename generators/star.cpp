@@ -5,9 +5,9 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/shaperasterizer.h"
 #include "base/textureimage.h"
 #include "star.h"
-#include <QPainter>
 #include <QtMath>
 #include <cmath>
 
@@ -119,6 +119,29 @@ StarTextureGenerator::StarTextureGenerator()
 }
 
 
+/**
+ * @brief StarTextureGenerator::starPolygon
+ * @param arms Number of arms
+ * @param innerRadius Radius of the points between the arms
+ * @param outerRadius Radius of the arms' tips
+ * @param width Width of the star in pixels
+ * @param height Height of the star in pixels
+ * @return The star's corners, relative to its center
+ */
+QVector<QPointF> StarTextureGenerator::starPolygon(double arms, double innerRadius, double outerRadius,
+                                                   double width, double height) const
+{
+   QVector<QPointF> polygon;
+   for (int i = 0; i < 2 * arms; i++) {
+      // Use outer or inner radius depending on what iteration we are in.
+      double r = (i & 1) == 0 ? outerRadius : innerRadius;
+      polygon.append(QPointF(0.5 * cos(i * M_PI / arms) * r * width,
+                             0.5 * sin(i * M_PI / arms) * r * height));
+   }
+   return polygon;
+}
+
+
 void StarTextureGenerator::generate(QSize size,
                                     TexturePixel* destimage,
                                     QMap<int, TextureImagePtr> sourceimages,
@@ -147,44 +170,41 @@ void StarTextureGenerator::generate(QSize size,
       memset(destimage, 0, size.width() * size.height() * sizeof(TexturePixel));
    }
 
-   QImage tempimage = QImage(size.width(), size.height(), QImage::Format_RGB32);
-   memcpy(tempimage.bits(), destimage, size.width() * size.height() * sizeof(TexturePixel));
-
-   offsetLeft += (double) 50 * size.width() / 100;
-   offsetTop += (double) 50 * size.height() / 100;
-
-   QPainter painter(&tempimage);
-   painter.translate(offsetLeft, offsetTop);
-   painter.rotate(rotation);
-   painter.translate(-shapeWidth / 2, -shapeHeight / 2);
-   painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-   painter.setBrush(QBrush(color, Qt::BrushStyle::SolidPattern));
-   QPainterPath path;
-
-   QPolygonF starPolygon;
-   for (int i = 0; i < 2 * arms; i++) {
-      // Use outer or inner radius depending on what iteration we are in.
-      double r = (i&  1) == 0 ? outerRadius : innerRadius;
-      starPolygon << QPointF(0.5 + 0.5 * cos(i * M_PI / arms) * r,
-                             0.5 + 0.5 * sin(i * M_PI / arms) * r);
+   if (arms <= 0) {
+      return;
    }
-
-   QPolygonF removeStarPolygon;
-   for (int i = 0; i < 2 * arms; i++) {
-      // Use outer or inner radius depending on what iteration we are in.
-      double r = (i&  1) == 0 ? cutoutOuterRadius : cutoutInnerRadius;
-      removeStarPolygon << QPointF(0.5 + 0.5 * cos(i * M_PI / arms) * r,
-                                   0.5 + 0.5 * sin(i * M_PI / arms) * r);
+   QVector<QPointF> star = starPolygon(arms, innerRadius, outerRadius, shapeWidth, shapeHeight);
+   QVector<QPointF> cutout;
+   if (cutoutInnerRadius > 0 || cutoutOuterRadius > 0) {
+      cutout = starPolygon(arms, cutoutInnerRadius, cutoutOuterRadius, shapeWidth, shapeHeight);
    }
-   path.addPolygon(starPolygon);
-   QPainterPath removepath;
-   removepath.addPolygon(removeStarPolygon);
-   path = path.subtracted(removepath);
-
-   painter.scale(shapeWidth, shapeHeight);
-   painter.setRenderHint(QPainter::Antialiasing, antialiasing);
-   painter.setPen(Qt::NoPen);
-   painter.drawPath(path);
-
-   memcpy(destimage, tempimage.bits(), size.width() * size.height() * sizeof(TexturePixel));
+   // Pixels further away than this from the center can't be covered.
+   float maxRadius = 0.5 * qMax(innerRadius, outerRadius) * qMax(shapeWidth, shapeHeight) + 1;
+
+   float centerX = offsetLeft + (double) 50 * size.width() / 100;
+   float centerY = offsetTop + (double) 50 * size.height() / 100;
+   double angle = (rotation / 180.0) * ((double) M_PI);
+   float cosAngle = cos(angle);
+   float sinAngle = sin(angle);
+
+   ShapeRasterizer::fill(size, QRect(QPoint(0, 0), size), destimage, color,
+                         [&](int y, int startX, int count, float* coverage) {
+      float dy = y + 0.5f - centerY;
+      for (int i = 0; i < count; i++) {
+         float dx = startX + i + 0.5f - centerX;
+         if (dx * dx + dy * dy > maxRadius * maxRadius) {
+            coverage[i] = 0;
+            continue;
+         }
+         float localX = dx * cosAngle + dy * sinAngle;
+         float localY = dy * cosAngle - dx * sinAngle;
+         float shape = ShapeRasterizer::edgeCoverage(
+                  ShapeRasterizer::polygonDistance(star, localX, localY), antialiasing);
+         if (!cutout.isEmpty() && shape > 0) {
+            shape *= 1 - ShapeRasterizer::edgeCoverage(
+                     ShapeRasterizer::polygonDistance(cutout, localX, localY), antialiasing);
+         }
+         coverage[i] = shape;
+      }
+   });
 }
@@ -8,6 +8,8 @@
 #define STARTEXTUREGENERATOR_H
 
 #include "texturegenerator.h"
+#include <QPointF>
+#include <QVector>
 
 /**
  * @brief The StarTextureGenerator class
@@ -28,6 +30,9 @@ public:
    TextureGenerator::Type getType() const override { return TextureGenerator::Type::Generator; }
 
 private:
+   QVector<QPointF> starPolygon(double arms, double innerRadius, double outerRadius,
+                                double width, double height) const;
+
    TextureGeneratorSettings configurables;
 };
 
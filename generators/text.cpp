@@ -5,10 +5,17 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/shaperasterizer.h"
 #include "text.h"
+#include <QMutexLocker>
 #include <QPainter>
 #include <cmath>
 
+/**
+ * Maximum memory used by cached text masks, in bytes.
+ */
+static const int maxMaskCacheSize = 32 * 1024 * 1024;
+
 TextTextureGenerator::TextTextureGenerator()
 {
    TextureGeneratorSetting colorsetting;
@@ -81,6 +88,58 @@ TextTextureGenerator::TextTextureGenerator()
    antialiasing.name = "Antialiasing";
    antialiasing.order = 8;
    configurables.insert("antialiasing", antialiasing);
+
+   maskcache.setMaxCost(maxMaskCacheSize);
+}
+
+
+/**
+ * @brief TextTextureGenerator::renderMask
+ * @param text The text to draw
+ * @param styleHint Font style
+ * @param pixelSize Font size in pixels
+ * @param rotation Rotation in degrees
+ * @param antialiasing If the glyphs' edges should be antialiased
+ * @return The text's coverage mask
+ *
+ * The text is laid out and rasterized into an 8-bit mask that is just
+ * large enough for the rotated text. The mask's origin is relative to
+ * the text's center.
+ */
+TextTextureGenerator::TextMask TextTextureGenerator::renderMask(const QString& text,
+                                                                QFont::StyleHint styleHint,
+                                                                int pixelSize, double rotation,
+                                                                bool antialiasing) const
+{
+   QFont font;
+   font.setPixelSize(pixelSize);
+   font.setStyleHint(styleHint);
+   font.setFamily(font.defaultFamily());
+   if (!antialiasing) {
+      font.setStyleStrategy(QFont::NoAntialias);
+   }
+   QFontMetrics fm(font);
+
+   QTransform transform;
+   transform.rotate(rotation);
+   transform.translate(-fm.width(text) / 2, -fm.height() / 2);
+   QRect layoutRect(0, 0, 100000, 100000);
+   QRect textRect = fm.boundingRect(layoutRect, 0, text);
+   QRect bounds = transform.mapRect(QRectF(textRect)).toAlignedRect().adjusted(-1, -1, 1, 1);
+
+   TextMask mask;
+   mask.origin = bounds.topLeft();
+   mask.coverage = QImage(bounds.size(), QImage::Format_Alpha8);
+   mask.coverage.fill(0);
+   QPainter painter(&mask.coverage);
+   painter.translate(-bounds.topLeft());
+   painter.setTransform(transform, true);
+   painter.setRenderHint(QPainter::Antialiasing, antialiasing);
+   painter.setRenderHint(QPainter::TextAntialiasing, antialiasing);
+   painter.setFont(font);
+   painter.setPen(QColor(0, 0, 0, 255));
+   painter.drawText(layoutRect, text);
+   return mask;
 }
 
 
@@ -125,27 +184,39 @@ void TextTextureGenerator::generate(QSize size,
       memset(destimage, 0, size.width() * size.height() * sizeof(TexturePixel));
    }
 
-   QImage tempimage = QImage(size.width(), size.height(), QImage::Format_RGB32);
-   memcpy(tempimage.bits(), destimage, size.width() * size.height() * sizeof(TexturePixel));
-
    offsetLeft += (double) 50 * size.width() / 100;
    offsetTop += (double) 50 * size.height() / 100;
 
-   QFont font;
-   font.setPixelSize(fontsize);
-   font.setStyleHint(styleHint);
-   font.setFamily(font.defaultFamily());
-   QFontMetrics fm(font);
-
-   QPainter painter(&tempimage);
-   painter.translate(offsetLeft, offsetTop);
-   painter.rotate(rotation);
-   painter.translate(-fm.width(text) / 2, -fm.height() / 2);
-   painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-   painter.setRenderHint(QPainter::Antialiasing, antialiasing);
-   painter.setFont(font);
-   painter.setPen(color);
-   painter.drawText(QRect(0, 0, size.width() * 10, size.height() * 10), text);
+   // The mask doesn't depend on the source image or the color, so when
+   // only those change the cached mask is just composited again.
+   int pixelSize = static_cast<int>(fontsize);
+   if (pixelSize < 1) {
+      return;
+   }
+   QString key = QString("%1|%2|%3|%4|%5").arg(fontname).arg(pixelSize)
+                 .arg(rotation).arg(antialiasing).arg(text);
+   TextMask mask;
+   bool cached = false;
+   {
+      QMutexLocker locker(&maskmutex);
+      if (TextMask* cachedMask = maskcache.object(key)) {
+         mask = *cachedMask;
+         cached = true;
+      }
+   }
+   if (!cached) {
+      mask = renderMask(text, styleHint, pixelSize, rotation, antialiasing);
+      QMutexLocker locker(&maskmutex);
+      maskcache.insert(key, new TextMask(mask), mask.coverage.bytesPerLine() * mask.coverage.height());
+   }
 
-   memcpy(destimage, tempimage.bits(), size.width() * size.height() * sizeof(TexturePixel));
+   const QImage& coverage = mask.coverage;
+   QPoint topLeft = mask.origin + QPoint(offsetLeft, offsetTop);
+   ShapeRasterizer::fill(size, QRect(topLeft, coverage.size()), destimage, color,
+                         [&](int y, int startX, int count, float* rowCoverage) {
+      const uchar* maskRow = coverage.constScanLine(y - topLeft.y()) + (startX - topLeft.x());
+      for (int i = 0; i < count; i++) {
+         rowCoverage[i] = maskRow[i] / 255.0f;
+      }
+   });
 }
@@ -9,6 +9,11 @@
 #define TEXTTEXTUREGENERATOR_H
 
 #include "texturegenerator.h"
+#include <QCache>
+#include <QFont>
+#include <QImage>
+#include <QMutex>
+#include <QPoint>
 
 /**
  * @brief The TextTextureGenerator class
@@ -29,7 +34,21 @@ public:
    TextureGenerator::Type getType() const override { return TextureGenerator::Type::Generator; }
 
 private:
+   /**
+    * The rasterized text, with the position of its top left
+    * corner relative to the text's center.
+    */
+   struct TextMask {
+      QImage coverage;
+      QPoint origin;
+   };
+
+   TextMask renderMask(const QString& text, QFont::StyleHint styleHint,
+                       int pixelSize, double rotation, bool antialiasing) const;
+
    TextureGeneratorSettings configurables;
+   mutable QCache<QString, TextMask> maskcache;
+   mutable QMutex maskmutex;
 };
 
 #endif // TEXTTEXTUREGENERATOR_H
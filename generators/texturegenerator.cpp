@@ -6,6 +6,7 @@
  */
 
 #include "texturegenerator.h"
+#include <QCoreApplication>
 #include <QString>
 
 /**
@@ -18,3 +19,15 @@ QString TextureGenerator::getSlotName(int id)
 {
    return QString("Slot %1").arg(id + 1);
 }
+
+/**
+ * @brief TextureGenerator::getCacheKey
+ * @return Data identifying the generator's implementation
+ * Part of the nodes' settings hashes, so that cached images are only
+ * reused by the implementation that rendered them. The built-in generators
+ * are versioned together with the application.
+ */
+QByteArray TextureGenerator::getCacheKey() const
+{
+   return QCoreApplication::applicationVersion().toUtf8();
+}
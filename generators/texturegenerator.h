@@ -35,6 +35,7 @@ public:
    virtual QString getName() const = 0;
    virtual QString getSlotName(int id);
    virtual QString getDescription() const = 0;
+   virtual QByteArray getCacheKey() const;
 };
 
 /**
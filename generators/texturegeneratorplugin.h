@@ -0,0 +1,45 @@
+/**
+ * Part of the ProceduralTextureMaker project.
+ * http://github.com/johanokl/ProceduralTextureMaker
+ * Released under GPLv3.
+ * Johan Lindqvist (johan.lindqvist@gmail.com)
+ */
+
+#ifndef TEXTUREGENERATORPLUGIN_H
+#define TEXTUREGENERATORPLUGIN_H
+
+#include "texturegenerator.h"
+#include <QList>
+#include <QtPlugin>
+
+/**
+ * @brief The TextureGeneratorPlugin class
+ *
+ * Interface for shared libraries adding native TextureGenerators.
+ * A plugin is a QObject implementing this interface, declared with
+ *
+ *    Q_OBJECT
+ *    Q_PLUGIN_METADATA(IID TextureGeneratorPlugin_iid)
+ *    Q_INTERFACES(TextureGeneratorPlugin)
+ *
+ * and built against the same headers and Qt version as the application.
+ * Q_PLUGIN_METADATA can also name a JSON file with a "version" field,
+ * which should be increased whenever a generator's output changes. It's
+ * part of the generators' cache keys, together with the library's file
+ * name and modification time.
+ * The generators describe their settings and source slots the same way
+ * as the built-in ones. The interface's version is part of the IID and
+ * must be increased when TextureGenerator or this class changes.
+ */
+class TextureGeneratorPlugin
+{
+public:
+   virtual ~TextureGeneratorPlugin() = default;
+   virtual QList<TextureGeneratorPtr> createGenerators() = 0;
+};
+
+#define TextureGeneratorPlugin_iid "com.github.johanokl.ProceduralTextureMaker.TextureGeneratorPlugin/1.0"
+
+Q_DECLARE_INTERFACE(TextureGeneratorPlugin, TextureGeneratorPlugin_iid)
+
+#endif // TEXTUREGENERATORPLUGIN_H
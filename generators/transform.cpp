@@ -5,8 +5,12 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/parallelbands.h"
+#include "base/shaperasterizer.h"
+#include "base/warpsampler.h"
 #include "transform.h"
-#include <QPainter>
+#include <QColor>
+#include <cmath>
 
 TransformTextureGenerator::TransformTextureGenerator()
 {
@@ -102,9 +106,28 @@ TransformTextureGenerator::TransformTextureGenerator()
    secondYtiles.group = "second tiles";
    secondYtiles.order = 10;
    configurables.insert("secondYtiles", secondYtiles);
+
+   QStringList filterings;
+   filterings.append("Nearest");
+   filterings.append("Bilinear");
+   TextureGeneratorSetting filtering;
+   filtering.name = "Filtering";
+   filtering.description = "How the source image is sampled";
+   filtering.defaultvalue = QVariant(filterings);
+   filtering.order = 11;
+   configurables.insert("filtering", filtering);
 }
 
 
+/**
+ * @brief TransformTextureGenerator::generate
+ *
+ * Every destination pixel is mapped back through the inverse of the
+ * transform. The result is inside the area covered by the first pass'
+ * tiles or shows the background. The second pass' tiles only multiply the
+ * coordinate before it's wrapped to the source's size, so no tiled
+ * images are created.
+ */
 void TransformTextureGenerator::generate(QSize size,
                                          TexturePixel* destimage,
                                          QMap<int, TextureImagePtr> sourceimages,
@@ -114,56 +137,72 @@ void TransformTextureGenerator::generate(QSize size,
       return;
    }
 
+   int width = size.width();
+   int height = size.height();
    double scaleX = settings->value("xscale").toDouble() / 100;
    double scaleY = settings->value("yscale").toDouble() / 100;
    double rotation = settings->value("rotation").toDouble();
-   int offsetLeft = settings->value("offsetleft").toDouble() * size.width() / 100;
-   int offsetTop = settings->value("offsettop").toDouble() * size.height() / 100;
+   int offsetLeft = settings->value("offsetleft").toDouble() * width / 100;
+   int offsetTop = settings->value("offsettop").toDouble() * height / 100;
    int firstXtiles = settings->value("firstXtiles").toInt();
    int firstYtiles = settings->value("firstYtiles").toInt();
    int secondXtiles = settings->value("secondXtiles").toInt();
    int secondYtiles = settings->value("secondYtiles").toInt();
+   WarpSampler::Filter filter = WarpSampler::getFilter(settings);
    QColor backgroundcolor = settings->value("backgroundcolor").value<QColor>();
-
-   QImage tempimage(size.width(), size.height(), QImage::Format_ARGB32);
-
-   if (sourceimages.contains(0)) {
-      memcpy(tempimage.bits(), sourceimages.value(0)->getData(), size.width() * size.height() * sizeof(TexturePixel));
-   } else {
-      memset(tempimage.bits(), 0, size.width() * size.height() * sizeof(TexturePixel));
-   }
-
-   QImage tiledimage(size.width(), size.height(), QImage::Format_ARGB32);
-   memset(tiledimage.bits(), 0, size.width() * size.height() * sizeof(TexturePixel));
-
-   QPainter firstpainter(&tiledimage);
-   firstpainter.scale((double) 1 / secondXtiles, (double) 1 / secondYtiles);
-   firstpainter.fillRect(0, 0, secondXtiles * tempimage.width(), secondYtiles * tempimage.height(), QBrush(tempimage));
-
-   QImage destBuffer(firstXtiles * size.width(), firstYtiles * size.height(), QImage::Format_ARGB32);
-   TexturePixel col(backgroundcolor.red(), backgroundcolor.green(), backgroundcolor.blue(), backgroundcolor.alpha());
-
-   auto* destBufferPixels = (TexturePixel*) destBuffer.bits();
-   int numPixels = firstXtiles * size.width() * firstYtiles * size.height();
-   for (int i=0; i < numPixels; i++) {
-      *destBufferPixels = col;
-      destBufferPixels++;
+   TexturePixel background(backgroundcolor.red(), backgroundcolor.green(),
+                           backgroundcolor.blue(), backgroundcolor.alpha());
+
+   int numPixels = width * height;
+   if (!sourceimages.contains(0) || scaleX == 0 || scaleY == 0) {
+      for (int i = 0; i < numPixels; i++) {
+         destimage[i] = background;
+      }
+      return;
    }
-
-   QPainter painter(&destBuffer);
-   painter.translate(offsetLeft, offsetTop);
-   painter.translate(size.width() / 2, size.height() / 2);
-   painter.rotate(rotation);
-   painter.scale(scaleX, scaleY);
-   painter.translate(-firstXtiles * size.width() / 2, -firstYtiles * size.height() / 2);
-   painter.fillRect(0, 0, destBuffer.width(), destBuffer.height(), QBrush(tiledimage));
-
-   memset(tempimage.bits(), 0, size.width() * size.height() * sizeof(TexturePixel));
-
-   QPainter finalpainter(&tempimage);
-   finalpainter.drawImage(QRectF(0, 0, size.width(), size.height()),
-                          destBuffer,
-                          QRectF(0, 0, size.width(), size.height()));
-
-   memcpy(destimage, tempimage.bits(), size.width() * size.height() * sizeof(TexturePixel));
+   const TexturePixel* source = sourceimages.value(0)->getData();
+
+   // Inverse of: translate(offset + center) * rotate * scale * translate(-tiles center)
+   double angle = (rotation / 180.0) * ((double) M_PI);
+   double cosAngle = cos(angle);
+   double sinAngle = sin(angle);
+   double stepXX = cosAngle / scaleX;
+   double stepXY = -sinAngle / scaleY;
+   double stepYX = sinAngle / scaleX;
+   double stepYY = cosAngle / scaleY;
+   double centerX = offsetLeft + width / 2;
+   double centerY = offsetTop + height / 2;
+   double tilesCenterX = firstXtiles * width / 2;
+   double tilesCenterY = firstYtiles * height / 2;
+   double tilesWidth = firstXtiles * width;
+   double tilesHeight = firstYtiles * height;
+
+   ParallelBands::run(height, [&](int startY, int endY) {
+      for (int y = startY; y < endY; y++) {
+         double dy = y + 0.5 - centerY;
+         double dx = 0.5 - centerX;
+         double localX = dx * stepXX + dy * stepYX + tilesCenterX;
+         double localY = dx * stepXY + dy * stepYY + tilesCenterY;
+         TexturePixel* destRow = destimage + y * width;
+         for (int x = 0; x < width; x++, localX += stepXX, localY += stepXY) {
+            if (localX < 0 || localY < 0 || localX >= tilesWidth || localY >= tilesHeight) {
+               destRow[x] = background;
+               continue;
+            }
+            // Reduced to the source's size before going to float.
+            double sourceX = std::fmod(localX * secondXtiles, width) - 0.5;
+            double sourceY = std::fmod(localY * secondYtiles, height) - 0.5;
+            TexturePixel pixel = WarpSampler::sample(source, size, sourceX, sourceY,
+                                                     WarpSampler::Edges::Wrap, filter);
+            if (pixel.a == 255 || background.a == 0) {
+               destRow[x] = pixel;
+            } else {
+               destRow[x] = background;
+               if (pixel.a > 0) {
+                  ShapeRasterizer::compositeOver(destRow[x], pixel, pixel.a / 255.0f);
+               }
+            }
+         }
+      }
+   });
 }
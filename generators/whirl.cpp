@@ -5,6 +5,7 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/warpsampler.h"
 #include "whirl.h"
 #include <QtMath>
 #include <cmath>
@@ -42,6 +43,8 @@ WhirlTextureGenerator::WhirlTextureGenerator()
    offsettop.max = QVariant(100);
    offsettop.order = 4;
    configurables.insert("offsettop", offsettop);
+
+   WarpSampler::addSettings(configurables, 5);
 }
 
 
@@ -64,27 +67,29 @@ void WhirlTextureGenerator::generate(QSize size,
    double offsettop = settings->value("offsettop").toDouble() * size.height() / 100;
 
    TexturePixel* source = sourceimages.value(0)->getData();
+   if (radius <= 0) {
+      memcpy(destimage, source, size.width() * size.height() * sizeof(TexturePixel));
+      return;
+   }
    int centerx = size.width() / 2 + offsetleft;
    int centery = size.height() / 2 + offsettop;
+   float whirlRadius = radius;
+   float angleFactor = 2 * M_PI * strength / radius;
 
-   for (int y = 0; y < size.height(); y++) {
-      for (int x = 0; x < size.width(); x++) {
-         double distortion = sqrt((x - centerx) * (x - centerx) + (y - centery) * (y - centery));
-         if (distortion > radius) {
-            distortion = 0;
-         } else {
-            distortion = (radius - distortion) * (radius - distortion) / radius;
+   WarpSampler::warp(size, destimage, source, [=](int y, int width, float* sourceX, float* sourceY) {
+      float dy = y - centery;
+      for (int x = 0; x < width; x++) {
+         float dx = x - centerx;
+         float distance = std::sqrt(dx * dx + dy * dy);
+         float distortion = 0;
+         if (distance <= whirlRadius) {
+            distortion = (whirlRadius - distance) * (whirlRadius - distance) / whirlRadius;
          }
-         double angle = 2 * M_PI * distortion / (radius / strength);
-         int xpos = ((x - centerx) * cos(angle)) - ((y - centery) * sin(angle)) + centerx;
-         int ypos = ((y - centery) * cos(angle)) + ((x - centerx) * sin(angle)) + centery;
-         xpos = xpos > size.height() ? xpos % size.height() :
-                                       (xpos < 0 ? xpos + size.width() : xpos);
-         ypos = ypos > size.height() ? ypos % size.height() :
-                                       (ypos < 0 ? ypos + size.height() : ypos);
-         xpos = qMax(qMin(xpos, size.width() - 1), 0);
-         ypos = qMax(qMin(ypos, size.height() - 1), 0);
-         destimage[y * size.width() + x] = source[ypos * size.width() + xpos];
+         float angle = angleFactor * distortion;
+         float cosAngle = std::cos(angle);
+         float sinAngle = std::sin(angle);
+         sourceX[x] = dx * cosAngle - dy * sinAngle + centerx;
+         sourceY[x] = dy * cosAngle + dx * sinAngle + centery;
       }
-   }
+   }, WarpSampler::getEdges(settings), WarpSampler::getFilter(settings));
 }
@@ -47,6 +47,16 @@ public:
       return ret;
    }
 
+   /**
+    * @brief TexturePixel::toARGB
+    * @return the pixel as ARGB, same as its memory read as a
+    *         little-endian 32 bit value
+    */
+   quint32 toARGB() const {
+      return (static_cast<quint32>(a) << 24) | (static_cast<quint32>(r) << 16) |
+            (static_cast<quint32>(g) << 8) | static_cast<quint32>(b);
+   }
+
    TexturePixel& operator+=(const TexturePixel& rhs) {
       r = static_cast<unsigned char>(qMin(static_cast<int>(rhs.r) + static_cast<int>(r), 255));
       g = static_cast<unsigned char>(qMin(static_cast<int>(rhs.g) + static_cast<int>(g), 255));
@@ -5,6 +5,7 @@
  * Johan Lindqvist (johan.lindqvist@gmail.com)
  */
 
+#include "base/exportjob.h"
 #include "base/settingsmanager.h"
 #include "base/textureimage.h"
 #include "base/texturenode.h"
@@ -16,6 +17,7 @@
 #include "generators/circle.h"
 #include "generators/cutout.h"
 #include "generators/displacementmap.h"
+#include "generators/expression.h"
 #include "generators/fill.h"
 #include "generators/fire.h"
 #include "generators/gaussianblur.h"
@@ -33,6 +35,7 @@
 #include "generators/normalmap.h"
 #include "generators/perlinnoise.h"
 #include "generators/pixelate.h"
+#include "generators/plugins.h"
 #include "generators/pointillism.h"
 #include "generators/setchannels.h"
 #include "generators/shadow.h"
@@ -57,12 +60,14 @@
 #include "sceneview/viewnodeview.h"
 #include "texgenapplication.h"
 #include <QAction>
+#include <QBuffer>
 #include <QCheckBox>
 #include <QCloseEvent>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QMessageBox>
+#include <QProgressDialog>
 #include <QPushButton>
 #include <QSettings>
 #include <QSplitter>
@@ -109,6 +114,7 @@ MainWindow::MainWindow(TexGenApplication* parent)
    project->addGenerator(TextureGeneratorPtr(new CircleTextureGenerator()));
    project->addGenerator(TextureGeneratorPtr(new CutoutTextureGenerator()));
    project->addGenerator(TextureGeneratorPtr(new DisplacementMapTextureGenerator()));
+   project->addGenerator(TextureGeneratorPtr(new ExpressionTextureGenerator()));
    project->addGenerator(TextureGeneratorPtr(new FillTextureGenerator()));
    project->addGenerator(TextureGeneratorPtr(new FireTextureGenerator()));
    project->addGenerator(TextureGeneratorPtr(new GaussianBlurTextureGenerator()));
@@ -139,6 +145,7 @@ MainWindow::MainWindow(TexGenApplication* parent)
    project->clear();
 
    jstexgenManager = new JSTexGenManager(project);
+   plugintexgenManager = new PluginTexGenManager(project);
 
    auto* centerLayout = new QVBoxLayout;
    centerLayout->addWidget(view);
@@ -192,6 +199,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
  */
 MainWindow::~MainWindow()
 {
+   qDeleteAll(findChildren<ExportJob*>(QString(), Qt::FindDirectChildrenOnly));
    delete menuactions;
    delete scene;
    delete view;
@@ -237,7 +245,8 @@ void MainWindow::generatorNameCollision(const TextureGeneratorPtr& oldGen, const
  * @param newFileName Don't reuse the previous saved file, ask for a new location.
  * @return true if suceesfully saved
  *
- * Saves the project as an xml file.
+ * Saves the project as an xml file, or in the binary format with the
+ * rendered images included if the file name ends with .txb.
  */
 bool MainWindow::saveFile(bool newFileName)
 {
@@ -247,7 +256,7 @@ bool MainWindow::saveFile(bool newFileName)
    }
    if (fileName.isNull()) {
       fileName = QFileDialog::getSaveFileName(this, "Save File", QDir::homePath(),
-                                              "Texture Set (*.txl)");
+                                              "Texture Set (*.txl);;Binary Texture Set (*.txb)");
    }
    if (fileName.isNull()) {
       return false;
@@ -268,12 +277,22 @@ bool MainWindow::saveFile(bool newFileName)
          return false;
       }
    }
+   bool binaryFile = (testFile.suffix().toLower() == "txb");
    QFile outputFile(fileName);
-   if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+   QIODevice::OpenMode openMode = QIODevice::WriteOnly;
+   if (!binaryFile) {
+      openMode |= QIODevice::Text;
+   }
+   if (!outputFile.open(openMode)) {
       QMessageBox::warning(this, "Error", "Could not save file to this location.");
       return false;
    }
-   QByteArray sceneFile = project->saveAsXML().toString(3).toLatin1();
+   QByteArray sceneFile;
+   if (binaryFile) {
+      sceneFile = project->saveAsBinary();
+   } else {
+      sceneFile = project->saveAsXML().toString(3).toLatin1();
+   }
    outputFile.write(sceneFile);
    outputFile.close();
 #ifdef Q_OS_MAC
@@ -345,6 +364,11 @@ void MainWindow::pasteNode()
 
 /**
  * @brief MainWindow::saveImage
+ * @param id Node id, or 0 for the selected node.
+ *
+ * Saves the node's image in the preview size as a PNG file, or as a block
+ * compressed DDS or KTX file depending on the file name. The image
+ * is rendered and encoded in the background, see runExportJob().
  */
 void MainWindow::saveImage(int id)
 {
@@ -355,7 +379,8 @@ void MainWindow::saveImage(int id)
    if (texNode.isNull()) {
       return;
    }
-   QString fileName = QFileDialog::getSaveFileName(this, "Save File", QDir::homePath(), "PNG (*.png)");
+   QString fileName = QFileDialog::getSaveFileName(this, "Save File", QDir::homePath(),
+                                                   "PNG (*.png);;DDS (*.dds);;KTX (*.ktx)");
 
    if (fileName.isNull()) {
       return;
@@ -376,12 +401,88 @@ void MainWindow::saveImage(int id)
          return;
       }
    }
-   QSize outSize = project->getPreviewSize();
-   QImage tempimage = QImage(outSize.width(), outSize.height(), QImage::Format_ARGB32);
-   memcpy(tempimage.bits(),
-          texNode->getImage(outSize)->getData(),
-          outSize.width() * outSize.height() * sizeof(TexturePixel));
-   tempimage.save(fileName, "PNG", 100);
+   ExportJob::Task task;
+   task.nodeId = id;
+   task.size = project->getPreviewSize();
+   task.fileName = fileName;
+   task.format = testFile.suffix().toUpper().toLatin1();
+   if (task.format != "DDS" && task.format != "KTX") {
+      task.format = "PNG";
+   }
+   task.compression = ExportJob::getCompression(texNode, settingsManager->getExportCompression());
+   runExportJob(new ExportJob(project, QList<ExportJob::Task>() << task));
+}
+
+/**
+ * @brief MainWindow::exportImages
+ *
+ * Exports the images of all the nodes to a directory, in the preview size
+ * and the export format from the settings. The files are named after the nodes.
+ * Asks before overwriting files that already exist.
+ */
+void MainWindow::exportImages()
+{
+   if (project->getNumNodes() == 0) {
+      return;
+   }
+   QString directory = QFileDialog::getExistingDirectory(this, "Export Images", QDir::homePath());
+   if (directory.isNull()) {
+      return;
+   }
+   QList<ExportJob::Task> tasks = ExportJob::createTasks(project, project->getNodeIds(),
+                                                         QList<QSize>() << project->getPreviewSize(),
+                                                         QStringList(settingsManager->getExportFormat()),
+                                                         directory, settingsManager->getExportCompression());
+   int numExisting = 0;
+   for (const ExportJob::Task& task : tasks) {
+      if (QFileInfo::exists(task.fileName)) {
+         numExisting++;
+      }
+   }
+   if (numExisting > 0) {
+      QMessageBox msgBox(this);
+      msgBox.setText(QString("%1 of the files already exist in this directory. \n"
+                             "Still want to save and thus overwrite the files or do you want to cancel the operation?")
+                     .arg(numExisting));
+      msgBox.setStandardButtons(QMessageBox::Save | QMessageBox::Cancel);
+      msgBox.setDefaultButton(QMessageBox::Cancel);
+      if (msgBox.exec() != QMessageBox::Save) {
+         return;
+      }
+   }
+   runExportJob(new ExportJob(project, tasks));
+}
+
+/**
+ * @brief MainWindow::runExportJob
+ * @param job The job, owned by the window from now on.
+ *
+ * Starts the job and shows its progress in a dialog that doesn't block the
+ * window, with a button for cancelling the job. Files that couldn't be
+ * written are listed when the job has finished.
+ */
+void MainWindow::runExportJob(ExportJob* job)
+{
+   job->setParent(this);
+   auto* progressDialog = new QProgressDialog("Exporting images...", "Cancel", 0, job->getNumTasks(), this);
+   progressDialog->setWindowModality(Qt::NonModal);
+   progressDialog->setMinimumDuration(500);
+   QSharedPointer<QStringList> failedFiles(new QStringList);
+   QObject::connect(job, &ExportJob::progress,
+                    progressDialog, &QProgressDialog::setValue);
+   QObject::connect(progressDialog, &QProgressDialog::canceled,
+                    job, &ExportJob::cancel);
+   QObject::connect(job, &ExportJob::taskFailed,
+                    this, [failedFiles](const QString& fileName) { failedFiles->append(fileName); });
+   QObject::connect(job, &ExportJob::finished, this, [=](bool) {
+      progressDialog->deleteLater();
+      job->deleteLater();
+      if (!failedFiles->isEmpty()) {
+         QMessageBox::warning(this, "Error", QString("Could not save the images:\n%1")
+                              .arg(failedFiles->join("\n")));
+      }
+   });
+   job->start();
 }
 
 /**
@@ -443,21 +544,48 @@ void MainWindow::openFile(const QString& fileName)
    if (!maybeSave()) {
       return;
    }
+   bool binaryFile = (QFileInfo(fileName).suffix().toLower() == "txb");
    QFile inputFile(fileName);
-   if (!inputFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+   QIODevice::OpenMode openMode = QIODevice::ReadOnly;
+   if (!binaryFile) {
+      openMode |= QIODevice::Text;
+   }
+   if (!inputFile.open(openMode)) {
       QMessageBox::warning(this, "Error", "Could not open the specified file.");
       return;
    }
-   if (QFileInfo(fileName).size() < 100) {
-      QMessageBox::warning(this, "Error", "File not a valid TXL file.");
-      return;
+   if (binaryFile) {
+      QByteArray inputData = inputFile.readAll();
+      if (!TextureProject::isBinaryProject(inputData)) {
+         QMessageBox::warning(this, "Error", "File not a valid TXB file.");
+         return;
+      }
+      project->clear();
+      if (!project->loadFromBinary(inputData)) {
+         QMessageBox::warning(this, "Error", "File not a valid TXB file.");
+         return;
+      }
+   } else {
+      if (QFileInfo(fileName).size() < 100) {
+         QMessageBox::warning(this, "Error", "File not a valid TXL file.");
+         return;
+      }
+      // The whole file is read and checked first, so that a read error or a
+      // malformed document doesn't leave a partially loaded project behind.
+      QByteArray inputData = inputFile.readAll();
+      if (inputFile.error() != QFileDevice::NoError || !TextureProject::isXMLProject(inputData)) {
+         QMessageBox::warning(this, "Error", "File not a valid TXL file.");
+         return;
+      }
+      project->clear();
+      QBuffer inputBuffer(&inputData);
+      inputBuffer.open(QIODevice::ReadOnly);
+      if (!project->loadFromXML(&inputBuffer)) {
+         project->clear();
+         QMessageBox::warning(this, "Error", "File not a valid TXL file.");
+         return;
+      }
    }
-   QString inputString(inputFile.readAll());
-   QDomDocument inputXmlDocument;
-   inputXmlDocument.setContent(inputString);
-
-   project->clear();
-   project->loadFromXML(inputXmlDocument);
    savedFileName = fileName;
 #ifdef Q_OS_MAC
    setWindowTitle(QFileInfo(inputFile).fileName());
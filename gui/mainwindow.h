@@ -24,6 +24,8 @@ class Preview3dPanel;
 class SettingsPanel;
 class SettingsManager;
 class JSTexGenManager;
+class PluginTexGenManager;
+class ExportJob;
 
 /**
  * @brief The MainWindow class
@@ -56,6 +58,7 @@ public slots:
    void pasteNode();
    void cutNode();
    void saveImage(int id = 0);
+   void exportImages();
    void reloadSceneView();
    void moveToFront();
    void resetViewZoom();
@@ -65,6 +68,7 @@ private:
    void drawScene();
    void createActions();
    bool maybeSave();
+   void runExportJob(ExportJob* job);
    ViewNodeScene* createScene(ViewNodeScene* source = nullptr);
 
    TexGenApplication* parentapp;
@@ -76,6 +80,7 @@ private:
    ViewNodeView* view;
    SettingsManager* settingsManager;
    JSTexGenManager* jstexgenManager;
+   PluginTexGenManager* plugintexgenManager;
    ItemInfoPanel* iteminfopanel;
    SettingsPanel* settingspanel;
    AddNodePanel* addnodewidget;
@@ -52,6 +52,11 @@ MenuActions::MenuActions(MainWindow* parent)
    QObject::connect(saveImageAct, &QAction::triggered,
                     parent, &MainWindow::saveImage);
 
+   exportImagesAct = new QAction("Export all images", parent);
+   exportImagesAct->setStatusTip("Save the images of all nodes to a directory");
+   QObject::connect(exportImagesAct, &QAction::triggered,
+                    parent, &MainWindow::exportImages);
+
    closeAct = new QAction("Close window", parent);
    closeAct->setShortcut(QKeySequence::Close);
    closeAct->setStatusTip("Close the window");
@@ -163,6 +168,7 @@ MenuActions::MenuActions(MainWindow* parent)
    fileMenu->addAction(saveAsAct);
    fileMenu->addSeparator();
    fileMenu->addAction(saveImageAct);
+   fileMenu->addAction(exportImagesAct);
    fileMenu->addSeparator();
    fileMenu->addAction(closeAct);
    fileMenu->addAction(exitAct);
@@ -362,7 +368,8 @@ void MenuActions::toogleToolbars()
  */
 void MenuActions::openFile()
 {
-   QString fileName = QFileDialog::getOpenFileName(parent(), tr("Open File"), lastOpenedDirectory, "Texture Set (*.txl)");
+   QString fileName = QFileDialog::getOpenFileName(parent(), tr("Open File"), lastOpenedDirectory,
+                                                   "Texture Sets (*.txl *.txb)");
    if (fileName.isNull()) {
       return;
    }
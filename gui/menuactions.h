@@ -78,6 +78,7 @@ private:
    QAction* saveAct;
    QAction* saveAsAct;
    QAction* saveImageAct;
+   QAction* exportImagesAct;
    QAction* closeAct;
    QAction* exitAct;
    QAction* clearAct;
@@ -119,6 +119,27 @@ SettingsPanel::SettingsPanel(MainWindow *parent, SettingsManager* settingsmanage
    exportLayout->addWidget(exportImageHeightLabel, 1, 0);
    exportLayout->addWidget(exportImageHeightSpinbox, 1, 1);
 
+   QLabel* exportFormatLabel = new QLabel("Export format:");
+   exportFormatCombobox = new QComboBox(this);
+   exportFormatCombobox->addItem("PNG", "png");
+   exportFormatCombobox->addItem("DDS", "dds");
+   exportFormatCombobox->addItem("KTX", "ktx");
+   exportLayout->addWidget(exportFormatLabel, 2, 0);
+   exportLayout->addWidget(exportFormatCombobox, 2, 1);
+
+   QLabel* exportCompressionLabel = new QLabel("Block compression:");
+   exportCompressionCombobox = new QComboBox(this);
+   exportCompressionCombobox->setToolTip("Used for DDS and KTX files. Automatic uses BC5 "
+                                         "for normal maps and BC7 for other images.");
+   exportCompressionCombobox->addItem("Automatic", "Auto");
+   exportCompressionCombobox->addItem("BC1 (RGB)", "BC1");
+   exportCompressionCombobox->addItem("BC3 (RGBA)", "BC3");
+   exportCompressionCombobox->addItem("BC4 (Red)", "BC4");
+   exportCompressionCombobox->addItem("BC5 (Red and green)", "BC5");
+   exportCompressionCombobox->addItem("BC7 (RGBA)", "BC7");
+   exportLayout->addWidget(exportCompressionLabel, 3, 0);
+   exportLayout->addWidget(exportCompressionCombobox, 3, 1);
+
    QGroupBox* generatorsWidget = new QGroupBox("JavaScript Generators");
    auto* generatorsLayout = new QGridLayout;
    generatorsWidget->setLayout(generatorsLayout);
@@ -141,6 +162,56 @@ SettingsPanel::SettingsPanel(MainWindow *parent, SettingsManager* settingsmanage
    generatorsLayout->addWidget(generatorEnabledLabel, 2, 0);
    generatorsLayout->addWidget(jsGeneratorEnabledCheckbox, 2, 1);
 
+   QGroupBox* pluginsWidget = new QGroupBox("Native Plugins");
+   auto* pluginsLayout = new QGridLayout;
+   pluginsWidget->setLayout(pluginsLayout);
+   pluginsWidget->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred);
+   contentsLayout->addWidget(pluginsWidget);
+
+   QLabel* pluginPathLabel = new QLabel("Path:");
+   pluginPathEdit = new QLineEdit(this);
+   pluginPathEdit->setReadOnly(true);
+   QPushButton* browsePluginPathButton = new QPushButton("Browse");
+   QObject::connect(browsePluginPathButton,
+                    static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
+                    [=](bool) { this->selectDirectoryPath(pluginPathEdit); });
+
+   QLabel* pluginEnabledLabel = new QLabel("Enabled:");
+   pluginEnabledCheckbox = new QCheckBox(this);
+   pluginsLayout->addWidget(pluginPathLabel, 0, 0);
+   pluginsLayout->addWidget(pluginPathEdit, 0, 1);
+   pluginsLayout->addWidget(browsePluginPathButton, 1, 1);
+   pluginsLayout->addWidget(pluginEnabledLabel, 2, 0);
+   pluginsLayout->addWidget(pluginEnabledCheckbox, 2, 1);
+
+   QGroupBox* renderCacheWidget = new QGroupBox("Render Cache");
+   auto* renderCacheLayout = new QGridLayout;
+   renderCacheWidget->setLayout(renderCacheLayout);
+   renderCacheWidget->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred);
+   contentsLayout->addWidget(renderCacheWidget);
+
+   QLabel* renderCachePathLabel = new QLabel("Path:");
+   renderCachePathEdit = new QLineEdit(this);
+   renderCachePathEdit->setReadOnly(true);
+   QPushButton* browseRenderCachePathButton = new QPushButton("Browse");
+   QObject::connect(browseRenderCachePathButton,
+                    static_cast<void (QPushButton::*)(bool)>(&QPushButton::clicked),
+                    [=](bool) { this->selectDirectoryPath(renderCachePathEdit); });
+
+   QLabel* renderCacheSizeLabel = new QLabel("Max size (MB):");
+   renderCacheSizeSpinbox = new QSpinBox(this);
+   renderCacheSizeSpinbox->setMinimum(16);
+   renderCacheSizeSpinbox->setMaximum(65536);
+   QLabel* renderCacheEnabledLabel = new QLabel("Enabled:");
+   renderCacheEnabledCheckbox = new QCheckBox(this);
+   renderCacheLayout->addWidget(renderCachePathLabel, 0, 0);
+   renderCacheLayout->addWidget(renderCachePathEdit, 0, 1);
+   renderCacheLayout->addWidget(browseRenderCachePathButton, 1, 1);
+   renderCacheLayout->addWidget(renderCacheSizeLabel, 2, 0);
+   renderCacheLayout->addWidget(renderCacheSizeSpinbox, 2, 1);
+   renderCacheLayout->addWidget(renderCacheEnabledLabel, 3, 0);
+   renderCacheLayout->addWidget(renderCacheEnabledCheckbox, 3, 1);
+
    QGroupBox* previewWidget = new QGroupBox("Preview");
    auto* previewLayout = new QGridLayout;
    previewWidget->setLayout(previewLayout);
@@ -240,18 +311,31 @@ void SettingsPanel::settingsUpdated()
 {
    if (!blockSlot) {
       jsGeneratorPathEdit->setText(settingsmanager->getJSTextureGeneratorsPath());
+      pluginPathEdit->setText(settingsmanager->getPluginGeneratorsPath());
+      renderCachePathEdit->setText(settingsmanager->getRenderCachePath());
+      renderCacheSizeSpinbox->setValue(settingsmanager->getRenderCacheSize());
       exportImageWidthSpinbox->setValue(settingsmanager->getPreviewSize().width());
       exportImageHeightSpinbox->setValue(settingsmanager->getPreviewSize().height());
       thumbnailWidthSpinbox->setValue(settingsmanager->getThumbnailSize().width());
       thumbnailHeightSpinbox->setValue(settingsmanager->getThumbnailSize().height());
       defaultZoomSpinbox->setValue(settingsmanager->getDefaultZoom());
       jsGeneratorEnabledCheckbox->setChecked(settingsmanager->getJSTextureGeneratorsEnabled());
+      pluginEnabledCheckbox->setChecked(settingsmanager->getPluginGeneratorsEnabled());
+      renderCacheEnabledCheckbox->setChecked(settingsmanager->getRenderCacheEnabled());
       styleColorButton(backgroundColorButton, settingsmanager->getBackgroundColor());
       styleColorButton(previewBackgroundColorButton, settingsmanager->getPreviewBackgroundColor());
       int index = backgroundBrushCombobox->findData(settingsmanager->getBackgroundBrush());
       if (index != -1) {
          backgroundBrushCombobox->setCurrentIndex(index);
       }
+      index = exportFormatCombobox->findData(settingsmanager->getExportFormat());
+      if (index != -1) {
+         exportFormatCombobox->setCurrentIndex(index);
+      }
+      index = exportCompressionCombobox->findData(settingsmanager->getExportCompression());
+      if (index != -1) {
+         exportCompressionCombobox->setCurrentIndex(index);
+      }
    }
 }
 
@@ -271,8 +355,15 @@ void SettingsPanel::saveSettings()
    thumbnailHeight = (thumbnailHeight % 2) ? (thumbnailHeight + 1) : thumbnailHeight;
    settingsmanager->setPreviewSize(QSize(exportImageWidth, exportImageHeight));
    settingsmanager->setThumbnailSize(QSize(thumbnailWidth, thumbnailHeight));
+   settingsmanager->setExportFormat(exportFormatCombobox->currentData().toString());
+   settingsmanager->setExportCompression(exportCompressionCombobox->currentData().toString());
    settingsmanager->setJSTextureGeneratorsPath(jsGeneratorPathEdit->text());
    settingsmanager->setJSTextureGeneratorsEnabled(jsGeneratorEnabledCheckbox->isChecked());
+   settingsmanager->setPluginGeneratorsPath(pluginPathEdit->text());
+   settingsmanager->setPluginGeneratorsEnabled(pluginEnabledCheckbox->isChecked());
+   settingsmanager->setRenderCachePath(renderCachePathEdit->text());
+   settingsmanager->setRenderCacheSize(renderCacheSizeSpinbox->value());
+   settingsmanager->setRenderCacheEnabled(renderCacheEnabledCheckbox->isChecked());
    settingsmanager->setDefaultZoom(defaultZoomSpinbox->value());
    settingsmanager->setPreviewBackgroundColor(QColor(previewBackgroundColorButton->text()));
    settingsmanager->setBackgroundColor(QColor(backgroundColorButton->text()));
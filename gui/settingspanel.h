@@ -56,9 +56,16 @@ private:
    QSpinBox* thumbnailHeightSpinbox;
    QSpinBox* exportImageWidthSpinbox;
    QSpinBox* exportImageHeightSpinbox;
+   QComboBox* exportFormatCombobox;
+   QComboBox* exportCompressionCombobox;
    QSpinBox* defaultZoomSpinbox;
    QLineEdit* jsGeneratorPathEdit;
    QCheckBox* jsGeneratorEnabledCheckbox;
+   QLineEdit* pluginPathEdit;
+   QCheckBox* pluginEnabledCheckbox;
+   QLineEdit* renderCachePathEdit;
+   QSpinBox* renderCacheSizeSpinbox;
+   QCheckBox* renderCacheEnabledCheckbox;
    QPushButton* backgroundColorButton;
    QPushButton* previewBackgroundColorButton;
    QComboBox* backgroundBrushCombobox;
@@ -13,6 +13,7 @@ int main(int argc, char**argv)
    QCoreApplication::setOrganizationName("Johan Lindqvist");
    QCoreApplication::setOrganizationDomain("github.com/johanokl");
    QCoreApplication::setApplicationName("ProceduralTextureMaker");
+   QCoreApplication::setApplicationVersion(APP_VERSION);
 
    TexGenApplication app(argc, argv);
    return app.exec();